@@ -0,0 +1,273 @@
+#include "../src/canvas.h"
+#include "../src/worldloader.h"
+#include "./world.h"
+#include <benchmark/benchmark.h>
+#include <nbt/view.hpp>
+
+// Benchmarks of the stages of a render, from the region files to the image
+//
+// They run on a synthetic world, written to the temporary directory the first
+// time it is needed, or on a recorded world. The environment selects it:
+//
+//   MCMAP_BENCH_WORLD    Region directory of a recorded world to use instead
+//   MCMAP_BENCH_SEED     Seed of the synthetic world (1)
+//   MCMAP_BENCH_REGIONS  Side of the synthetic world, in regions (1)
+//   MCMAP_BENCH_VARIETY  Block types per section of the synthetic world (16)
+//
+// The stages run on the chunks of region (0, 0), or on its first 8x8 chunks
+// when drawing.
+
+namespace {
+
+uint32_t setting(const char *name, uint32_t fallback) {
+  const char *value = getenv(name);
+  return value ? uint32_t(std::stoul(value)) : fallback;
+}
+
+struct Fixture {
+  Colors::Palette colors;
+  std::unique_ptr<Colors::Index> index;
+  fs::path regionDir;
+
+  static Fixture &get() {
+    static Fixture fixture;
+    return fixture;
+  }
+
+  // The region (0, 0) of the world
+  fs::path region() const { return regionDir / "r.0.0.mca"; }
+
+  // The decompressed data of every chunk of region (0, 0)
+  const std::vector<std::vector<uint8_t>> &chunks() {
+    if (decompressed.empty()) {
+      Region region(this->region());
+      std::vector<uint8_t> buffer;
+
+      for (uint16_t i = 0; i < REGIONSIZE * REGIONSIZE; i++) {
+        uint64_t length;
+
+        if (!region.chunk(i).empty() &&
+            Terrain::decompressChunk(region.chunk(i), buffer, &length))
+          decompressed.emplace_back(buffer.begin(), buffer.begin() + length);
+      }
+    }
+
+    return decompressed;
+  }
+
+private:
+  std::vector<std::vector<uint8_t>> decompressed;
+
+  Fixture() {
+    Colors::load(&colors);
+    index = std::make_unique<Colors::Index>(colors);
+
+    if (getenv("MCMAP_BENCH_WORLD")) {
+      regionDir = getenv("MCMAP_BENCH_WORLD");
+      return;
+    }
+
+    const SyntheticWorld world(colors, setting("MCMAP_BENCH_SEED", 1),
+                               setting("MCMAP_BENCH_VARIETY", 16));
+    const uint16_t regions = setting("MCMAP_BENCH_REGIONS", 1);
+
+    // The directory depends on everything the world is made from, for a
+    // world written by another generator or palette never to be used
+    regionDir = fs::temp_directory_path() /
+                fmt::format("mcmap-bench-{}-{}-{}-{:016x}", world.seed,
+                            world.variety, regions, world.digest());
+
+    if (fs::exists(regionDir))
+      return;
+
+    // The world is written aside and only moved in place once complete, for
+    // an interrupted run to leave nothing behind that could be used
+    const fs::path partial = fs::path(regionDir).concat(".partial");
+    std::error_code error;
+
+    fs::remove_all(partial, error);
+
+    if (!world.write(partial, regions)) {
+      fs::remove_all(partial, error);
+      throw std::runtime_error("Failed to write the synthetic world");
+    }
+
+    fs::rename(partial, regionDir, error);
+
+    if (error)
+      throw std::runtime_error(fmt::format(
+          "Failed to move the synthetic world in place: {}", error.message()));
+  }
+};
+
+// The 8x8 chunks of the world from the block (x, z)
+World::Coordinates fragment(int32_t x = 0, int32_t z = 0) {
+  return World::Coordinates(x, mcmap::constants::min_y, z, x + 127,
+                            mcmap::constants::max_y, z + 127);
+}
+
+void draw(IsometricCanvas &canvas, Terrain::Data &world,
+          const World::Coordinates &map, const Colors::Palette &colors,
+          const ColorTables &tables) {
+  canvas.setMap(map);
+  canvas.setColors(colors, &tables);
+  canvas.shading = false;
+  canvas.lighting = false;
+  canvas.renderTerrain(world);
+}
+
+void RegionHeader(benchmark::State &state) {
+  const fs::path file = Fixture::get().region();
+
+  for (auto _ : state) {
+    Region region(file);
+    benchmark::DoNotOptimize(region.locations.data());
+  }
+}
+BENCHMARK(RegionHeader);
+
+void Inflate(benchmark::State &state) {
+  Region region(Fixture::get().region());
+  std::vector<uint8_t> buffer;
+  size_t bytes = 0;
+
+  for (auto _ : state) {
+    for (uint16_t i = 0; i < REGIONSIZE * REGIONSIZE; i++) {
+      uint64_t length = 0;
+
+      if (!region.chunk(i).empty() &&
+          Terrain::decompressChunk(region.chunk(i), buffer, &length))
+        bytes += length;
+    }
+  }
+
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(Inflate)->Unit(benchmark::kMillisecond);
+
+void Parse(benchmark::State &state) {
+  const auto &chunks = Fixture::get().chunks();
+  size_t bytes = 0;
+
+  for (auto _ : state) {
+    for (const auto &chunk : chunks) {
+      nbt::View data;
+      nbt::index(chunk.data(), chunk.size(), data, &mcmap::Chunk::fields);
+      benchmark::DoNotOptimize(data);
+      bytes += chunk.size();
+    }
+  }
+
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * chunks.size());
+}
+BENCHMARK(Parse)->Unit(benchmark::kMillisecond);
+
+// Building the sections of chunks, with palettes of `variety` block types
+void Sections(benchmark::State &state) {
+  Fixture &fixture = Fixture::get();
+  const SyntheticWorld world(fixture.colors, 1, state.range(0));
+
+  std::vector<std::vector<uint8_t>> chunks;
+  std::vector<nbt::View> views(64);
+
+  for (int32_t i = 0; i < 64; i++) {
+    chunks.push_back(world.chunk(i % 8, i / 8));
+    nbt::index(chunks[i].data(), chunks[i].size(), views[i],
+               &mcmap::Chunk::fields);
+  }
+
+  for (auto _ : state) {
+    for (int32_t i = 0; i < 64; i++) {
+      mcmap::Chunk chunk(views[i], *fixture.index, {i % 8, i / 8});
+      benchmark::DoNotOptimize(chunk.sections.data());
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(Sections)->Arg(2)->Arg(16)->Arg(256)->Unit(benchmark::kMillisecond);
+
+// Drawing the sections of chunks already decoded
+void Draw(benchmark::State &state) {
+  Fixture &fixture = Fixture::get();
+  const ColorTables tables(*fixture.index, false, false);
+  const World::Coordinates map = fragment();
+
+  // The chunks are kept by the terrain once loaded by a first render
+  Terrain::Data world(map, fixture.regionDir, *fixture.index, nullptr,
+                      nullptr, true);
+  IsometricCanvas warmup;
+  draw(warmup, world, map, fixture.colors, tables);
+
+  for (auto _ : state) {
+    IsometricCanvas canvas;
+    draw(canvas, world, map, fixture.colors, tables);
+    benchmark::DoNotOptimize(canvas.rendered);
+  }
+
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(Draw)->Unit(benchmark::kMillisecond);
+
+// A composite of the 4x4 fragments of the region, each 8x8 chunks
+CompositeCanvas composite() {
+  Fixture &fixture = Fixture::get();
+  const ColorTables tables(*fixture.index, false, false);
+  std::vector<Canvas> fragments;
+
+  for (int32_t x = 0; x < 4; x++)
+    for (int32_t z = 0; z < 4; z++) {
+      const World::Coordinates map = fragment(x * 128, z * 128);
+      Terrain::Data world(map, fixture.regionDir, *fixture.index);
+      IsometricCanvas canvas;
+      draw(canvas, world, map, fixture.colors, tables);
+      fragments.push_back(std::move(canvas));
+    }
+
+  return CompositeCanvas(std::move(fragments));
+}
+
+void Compose(benchmark::State &state) {
+  const CompositeCanvas merged = composite();
+  std::vector<uint8_t> line(merged.width() * BYTESPERPIXEL);
+
+  for (auto _ : state) {
+    for (uint64_t y = 0; y < merged.height(); y++) {
+      std::fill(line.begin(), line.end(), 0);
+      merged.getLine(line.data(), line.size(), y);
+    }
+
+    benchmark::DoNotOptimize(line.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * merged.height() * line.size());
+}
+BENCHMARK(Compose)->Unit(benchmark::kMillisecond);
+
+void Encode(benchmark::State &state) {
+  const CompositeCanvas merged = composite();
+  const fs::path file = fs::temp_directory_path() / "mcmap-bench.png";
+
+  for (auto _ : state)
+    merged.save(file);
+
+  fs::remove(file);
+  state.SetBytesProcessed(state.iterations() * merged.height() *
+                          merged.width() * BYTESPERPIXEL);
+}
+BENCHMARK(Encode)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+int main(int argc, char **argv) {
+  logger::set_level(spdlog::level::warn);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,283 @@
+#include "./world.h"
+#include <fstream>
+#include <zlib.h>
+
+namespace {
+
+// Big-endian NBT output, enough to write chunks
+struct Writer {
+  enum Tag : uint8_t {
+    END = 0,
+    BYTE = 1,
+    INT = 3,
+    LONG = 4,
+    BYTE_ARRAY = 7,
+    STRING = 8,
+    LIST = 9,
+    COMPOUND = 10,
+    LONG_ARRAY = 12,
+  };
+
+  std::vector<uint8_t> data;
+
+  void integer(uint64_t value, uint8_t bytes) {
+    for (uint8_t i = bytes; i > 0; i--)
+      data.push_back(value >> (8 * (i - 1)));
+  }
+
+  void string(const std::string &value) {
+    integer(value.size(), 2);
+    data.insert(data.end(), value.begin(), value.end());
+  }
+
+  // The header of a named tag
+  void tag(Tag type, const std::string &name) {
+    data.push_back(type);
+    string(name);
+  }
+
+  // The header of a list, whose elements are written after
+  void list(const std::string &name, Tag type, uint32_t size) {
+    tag(LIST, name);
+    data.push_back(size ? type : END);
+    integer(size, 4);
+  }
+
+  void end() { data.push_back(END); }
+};
+
+} // namespace
+
+SyntheticWorld::SyntheticWorld(const Colors::Palette &palette, uint32_t seed,
+                               uint16_t variety)
+    : seed(seed), variety(std::min(std::max(variety, uint16_t(2)),
+                                   uint16_t(4096))),
+      bottom(-4), top(7) {
+  for (const auto &entry : palette)
+    if (entry.first != "minecraft:air" && entry.first != "minecraft:cave_air" &&
+        entry.first != "minecraft:void_air")
+      names.push_back(entry.first);
+
+  if (names.empty())
+    names.push_back("minecraft:stone");
+}
+
+uint64_t SyntheticWorld::mix(int64_t a, int64_t b, int64_t c,
+                             int64_t d) const {
+  // SplitMix64 over the values, one after the other
+  uint64_t state = seed;
+
+  for (int64_t value : {a, b, c, d}) {
+    state += uint64_t(value) + 0x9e3779b97f4a7c15;
+    state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9;
+    state = (state ^ (state >> 27)) * 0x94d049bb133111eb;
+    state ^= state >> 31;
+  }
+
+  return state;
+}
+
+std::vector<uint8_t> SyntheticWorld::chunk(int32_t x, int32_t z) const {
+  Writer out;
+
+  out.tag(Writer::COMPOUND, "");
+
+  out.tag(Writer::INT, "DataVersion");
+  out.integer(3120, 4);
+  out.tag(Writer::INT, "xPos");
+  out.integer(uint32_t(x), 4);
+  out.tag(Writer::INT, "zPos");
+  out.integer(uint32_t(z), 4);
+  out.tag(Writer::INT, "yPos");
+  out.integer(uint32_t(int32_t(bottom)), 4);
+  out.tag(Writer::STRING, "Status");
+  out.string("full");
+  out.tag(Writer::LONG, "LastUpdate");
+  out.integer(mix(x, z) & 0xffffff, 8);
+  out.tag(Writer::LONG, "InhabitedTime");
+  out.integer(0, 8);
+
+  // The height of the terrain in every column, from the bottom of the chunk
+  const int32_t span = (top - bottom + 1) * 16;
+  std::array<int32_t, 256> heights;
+
+  for (int32_t i = 0; i < 256; i++) {
+    const int64_t bx = x * 16 + (i & 0xf), bz = z * 16 + (i >> 4);
+
+    // Gentle slopes over 64 blocks, and some noise on top
+    const int64_t slope = (bx & 0x3f) < 32 ? bx & 0x1f : 32 - (bx & 0x1f),
+                  ridge = (bz & 0x3f) < 32 ? bz & 0x1f : 32 - (bz & 0x1f);
+    heights[i] = std::min<int64_t>(span * 2 / 3 + slope + ridge +
+                                       mix(bx, bz) % 4,
+                                   span - 1);
+  }
+
+  out.tag(Writer::COMPOUND, "Heightmaps");
+  for (const char *map : {"MOTION_BLOCKING", "WORLD_SURFACE"}) {
+    // 9 bits per column, 7 columns per long
+    out.tag(Writer::LONG_ARRAY, map);
+    out.integer(37, 4);
+    for (int i = 0; i < 37; i++) {
+      uint64_t packed = 0;
+      for (int j = 0; j < 7 && i * 7 + j < 256; j++)
+        packed |= uint64_t(heights[i * 7 + j] + 1) << (9 * j);
+      out.integer(packed, 8);
+    }
+  }
+  out.end();
+
+  out.list("sections", Writer::COMPOUND, top - bottom + 1);
+
+  for (int8_t y = bottom; y <= top; y++) {
+    const int32_t base = (y - bottom) * 16;
+
+    out.tag(Writer::BYTE, "Y");
+    out.data.push_back(uint8_t(y));
+
+    // The palette of the section: air first, then a window over the names
+    // starting at a position depending on the section
+    const size_t first = mix(x, y, z, 1) % names.size();
+    const uint16_t size = std::min<size_t>(variety, names.size() + 1);
+
+    std::array<uint16_t, 4096> blocks;
+    bool filled = false;
+
+    for (uint16_t i = 0; i < 4096; i++) {
+      const int32_t height = base + (i >> 8);
+      const int32_t column = i & 0xff;
+
+      // The floor is made of the first block of the palette
+      if (height > heights[column])
+        blocks[i] = 0;
+      else if (!height)
+        blocks[i] = 1;
+      else
+        blocks[i] = 1 + mix(x * 16 + (column & 0xf), height,
+                            z * 16 + (column >> 4)) %
+                            (size - 1);
+
+      filled |= blocks[i];
+    }
+
+    out.tag(Writer::COMPOUND, "block_states");
+    out.list("palette", Writer::COMPOUND, size);
+    for (uint16_t i = 0; i < size; i++) {
+      out.tag(Writer::STRING, "Name");
+      out.string(i ? names[(first + i - 1) % names.size()] : "minecraft:air");
+      out.end();
+    }
+
+    // Sections of air only are left without data, as the game does
+    if (filled) {
+      uint8_t bits = 4;
+      while ((1u << bits) < size)
+        bits++;
+
+      const uint16_t per_long = 64 / bits,
+                     longs = (4096 + per_long - 1) / per_long;
+
+      out.tag(Writer::LONG_ARRAY, "data");
+      out.integer(longs, 4);
+
+      for (uint16_t i = 0; i < longs; i++) {
+        uint64_t packed = 0;
+        for (uint16_t j = 0; j < per_long && i * per_long + j < 4096; j++)
+          packed |= uint64_t(blocks[i * per_long + j]) << (bits * j);
+        out.integer(packed, 8);
+      }
+    }
+    out.end();
+
+    out.tag(Writer::COMPOUND, "biomes");
+    out.list("palette", Writer::STRING, 1);
+    out.string("minecraft:plains");
+    out.end();
+
+    out.tag(Writer::BYTE_ARRAY, "BlockLight");
+    out.integer(2048, 4);
+    for (uint16_t i = 0; i < 2048; i++)
+      out.data.push_back(mix(x, y, z, i) % 3 ? 0 : 0x11 * (i % 16));
+
+    out.end();
+  }
+
+  out.end();
+  return out.data;
+}
+
+bool SyntheticWorld::region(const fs::path &file, int32_t x, int32_t z) const {
+  // The locations and timestamps, then the chunks aligned on 4KiB sectors
+  std::vector<uint8_t> contents(2 * 4096, 0);
+
+  for (uint16_t index = 0; index < 1024; index++) {
+    const std::vector<uint8_t> data =
+        chunk(x * 32 + (index & 0x1f), z * 32 + (index >> 5));
+
+    uLongf size = compressBound(data.size());
+    std::vector<uint8_t> compressed(size);
+    if (compress(compressed.data(), &size, data.data(), data.size()) != Z_OK)
+      return false;
+
+    const uint32_t length = size + 1, offset = contents.size() / 4096,
+                   sectors = (length + 4 + 4095) / 4096,
+                   location = (offset << 8) | sectors,
+                   timestamp = 1650000000 + mix(x, z, index) % 1000;
+
+    for (int i = 0; i < 4; i++) {
+      contents[index * 4 + i] = location >> (24 - 8 * i);
+      contents[4096 + index * 4 + i] = timestamp >> (24 - 8 * i);
+    }
+
+    const size_t start = contents.size();
+    contents.resize(start + sectors * 4096, 0);
+
+    for (int i = 0; i < 4; i++)
+      contents[start + i] = length >> (24 - 8 * i);
+    contents[start + 4] = 2;
+    memcpy(&contents[start + 5], compressed.data(), size);
+  }
+
+  std::ofstream output(file, std::ofstream::binary);
+  output.write(reinterpret_cast<const char *>(contents.data()),
+               contents.size());
+  output.close();
+
+  return bool(output);
+}
+
+uint64_t SyntheticWorld::digest() const {
+  // 64 bit FNV-1a, over the version and the names
+  uint64_t hash = 0xcbf29ce484222325;
+
+  auto add = [&hash](const std::string &value) {
+    for (char c : value)
+      hash = (hash ^ uint8_t(c)) * 0x100000001b3;
+
+    hash = (hash ^ 0xff) * 0x100000001b3;
+  };
+
+  add(std::to_string(version));
+  for (const std::string &name : names)
+    add(name);
+
+  return hash;
+}
+
+bool SyntheticWorld::write(const fs::path &directory,
+                           uint16_t regions) const {
+  std::error_code error;
+  fs::create_directories(directory, error);
+
+  if (error) {
+    logger::error("Failed to create directory {}: {}", directory.string(),
+                  error.message());
+    return false;
+  }
+
+  for (int32_t x = 0; x < regions; x++)
+    for (int32_t z = 0; z < regions; z++)
+      if (!region(directory / fmt::format("r.{}.{}.mca", x, z), x, z))
+        return false;
+
+  return true;
+}
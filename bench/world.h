@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../src/colors.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Synthetic world
+//
+// The benchmarks run on worlds generated from a seed, so their results can be
+// reproduced offline and compared from one commit to the next. The chunks are
+// written in the 1.19 format: columns of blocks up to a height picked for
+// every column, on top of a floor of a single block, in sections whose
+// palettes hold `variety` block types taken from the color palette. The chunks
+// also carry the tags the renderer skips (heightmaps, biomes, timestamps), to
+// be parsed like the chunks of a real world.
+//
+// The same seed and settings always give the same bytes: only the raw output
+// of the generator is used, as the standard distributions vary between
+// implementations.
+struct SyntheticWorld {
+  // Changes whenever the generator writes different data for the same input
+  static const uint32_t version = 1;
+
+  uint32_t seed;
+
+  // The amount of block types in a section, air included, from 2 to 4096
+  uint16_t variety;
+
+  // The sections of a chunk, from the bottom up, in section coordinates
+  int8_t bottom, top;
+
+  explicit SyntheticWorld(const Colors::Palette &, uint32_t seed = 1,
+                          uint16_t variety = 16);
+
+  // The uncompressed NBT data of the chunk at (x, z)
+  std::vector<uint8_t> chunk(int32_t x, int32_t z) const;
+
+  // Write the region file of the region at (x, z) to `file`
+  bool region(const fs::path &file, int32_t x, int32_t z) const;
+
+  // Write the `regions` x `regions` region files from region (0, 0) to
+  // `directory`
+  bool write(const fs::path &directory, uint16_t regions) const;
+
+  // A digest of everything the output depends on besides the settings: the
+  // version of the generator and the block names
+  uint64_t digest() const;
+
+private:
+  // The block names to build palettes from, air excluded
+  std::vector<std::string> names;
+
+  // A hash of the seed and the given values, the source of all randomness
+  uint64_t mix(int64_t, int64_t = 0, int64_t = 0, int64_t = 0) const;
+};
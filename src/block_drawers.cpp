@@ -10,10 +10,18 @@
 #define ALT_D &secondaryDark
 #define ALT_L &secondaryLight
 
-nbt::NBT empty;
+// Blend a line of 4 sprite colors over the 4 pixels from `pos`, at once
+inline void blendLine(uint8_t *pos, const Colors::Color *const line[4]) {
+  uint8_t pixels[4 * BYTESPERPIXEL];
+
+  for (uint8_t i = 0; i < 4; ++i)
+    memcpy(pixels + i * BYTESPERPIXEL, line[i], BYTESPERPIXEL);
+
+  blend(pos, pixels, 4);
+}
 
 void drawHead(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &, const Colors::Block *block) {
+              const BlockState &, const Colors::Block *block) {
   /* Small block centered
    * |    |
    * |    |
@@ -29,7 +37,7 @@ void drawHead(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 }
 
 void drawThin(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &, const Colors::Block *block) {
+              const BlockState &, const Colors::Block *block) {
   /* Overwrite the block below's top layer
    * |    |
    * |    |
@@ -45,12 +53,12 @@ void drawThin(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 }
 
 void drawHidden(IsometricCanvas *, const uint32_t, const uint32_t,
-                const nbt::NBT &, const Colors::Block *) {
+                const BlockState &, const Colors::Block *) {
   return;
 }
 
 void drawTransparent(IsometricCanvas *canvas, const uint32_t x,
-                     const uint32_t y, const nbt::NBT &,
+                     const uint32_t y, const BlockState &,
                      const Colors::Block *color) {
   uint8_t top = 0;
 
@@ -63,14 +71,12 @@ void drawTransparent(IsometricCanvas *canvas, const uint32_t x,
                                        {DARK_, DARK_, LIGHT, LIGHT}};
 
   // Avoid the top and dark/light edges for a clearer look through
-  uint8_t *pos = canvas->pixel(x, y + top);
-  for (uint8_t j = top; j < 4; ++j, pos = canvas->pixel(x, y + j))
-    for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-      blend(pos, (uint8_t *)sprite[j][i]);
+  for (uint8_t j = top; j < 4; ++j)
+    blendLine(canvas->pixel(x, y + j), sprite[j]);
 }
 
 void drawTorch(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-               const nbt::NBT &, const Colors::Block *block) {
+               const BlockState &, const Colors::Block *block) {
   /* TODO Callback to handle the orientation
    * Print the secondary on top of two primary
    * |    |
@@ -83,7 +89,7 @@ void drawTorch(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 }
 
 void drawPlant(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-               const nbt::NBT &metadata, const Colors::Block *color) {
+               const BlockState &state, const Colors::Block *color) {
   /* Print a plant-like block
    * TODO Make that nicer ?
    * |    |
@@ -92,22 +98,19 @@ void drawPlant(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
    * | X  | */
   Colors::Block *fill = &canvas->air;
 
-  if (metadata.contains("UnderWater"))
-    if (metadata["UnderWater"].get<string>() == "true")
-      fill = &canvas->water;
+  if (state.underwater)
+    fill = &canvas->water;
 
   const Colors::Color *sprite[3][4] = {{FILLD, PRIME, FILLL, PRIME},
                                        {FILLD, FILLD, PRIME, FILLL},
                                        {FILLD, PRIME, FILLL, FILLL}};
 
-  uint8_t *pos = canvas->pixel(x, y + 1);
-  for (uint8_t j = 0; j < 3; ++j, pos = canvas->pixel(x, y + j + 1))
-    for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-      blend(pos, (uint8_t *)sprite[j][i]);
+  for (uint8_t j = 0; j < 3; ++j)
+    blendLine(canvas->pixel(x, y + j + 1), sprite[j]);
 }
 
 void drawUnderwaterPlant(IsometricCanvas *canvas, const uint32_t x,
-                         const uint32_t y, const nbt::NBT &,
+                         const uint32_t y, const BlockState &,
                          const Colors::Block *color) {
   Colors::Block *fill = &canvas->water;
   uint8_t top = 0;
@@ -120,14 +123,12 @@ void drawUnderwaterPlant(IsometricCanvas *canvas, const uint32_t x,
                                        {FILLD, FILLD, PRIME, FILLL},
                                        {FILLD, PRIME, FILLL, FILLL}};
 
-  uint8_t *pos = canvas->pixel(x, y + top);
-  for (uint8_t j = top; j < 4; ++j, pos = canvas->pixel(x, y + j))
-    for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-      blend(pos, (uint8_t *)sprite[j][i]);
+  for (uint8_t j = top; j < 4; ++j)
+    blendLine(canvas->pixel(x, y + j), sprite[j]);
 }
 
 void drawFire(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &, const Colors::Block *const color) {
+              const BlockState &, const Colors::Block *const color) {
   // This basically just leaves out a few canvas->pixels
   // Top row
   uint8_t *pos = canvas->pixel(x, y);
@@ -146,7 +147,7 @@ void drawFire(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 }
 
 void drawOre(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-             const nbt::NBT &, const Colors::Block *color) {
+             const BlockState &, const Colors::Block *color) {
   /* Print a vein with the secondary in the block
    * |PSPP|
    * |DDSL|
@@ -165,14 +166,15 @@ void drawOre(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
                                        {DARK_, ALT_D, LIGHT, ALT_L},
                                        {ALT_D, DARK_, LIGHT, LIGHT}};
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
+  for (uint8_t j = 0; j < 4; ++j) {
+    uint8_t *pos = canvas->pixel(x, y + j);
     for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
       memcpy(pos, sprite[j][i], BYTESPERPIXEL);
+  }
 }
 
 void drawGrown(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-               const nbt::NBT &, const Colors::Block *color) {
+               const BlockState &, const Colors::Block *color) {
   /* Print the secondary color on top
    * |SSSS|
    * |DSSL|
@@ -193,14 +195,15 @@ void drawGrown(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
                                        {DARK_, DARK_, LIGHT, LIGHT},
                                        {DARK_, DARK_, LIGHT, LIGHT}};
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
+  for (uint8_t j = 0; j < 4; ++j) {
+    uint8_t *pos = canvas->pixel(x, y + j);
     for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
       memcpy(pos, sprite[j][i], BYTESPERPIXEL);
+  }
 }
 
 void drawRod(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-             const nbt::NBT &metadata, const Colors::Block *const color) {
+             const BlockState &state, const Colors::Block *const color) {
   /* A full fat rod
    * | PP |
    * | DL |
@@ -208,13 +211,8 @@ void drawRod(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
    * | DL | */
 
   Colors::Block *fill = &canvas->air;
-  std::string waterlogged = "false";
-
-  if (metadata.contains("Properties"))
-    if (metadata["Properties"].contains("waterlogged"))
-      waterlogged = metadata["Properties"]["waterlogged"].get<string>();
 
-  if (waterlogged == "true")
+  if (state.waterlogged)
     fill = &canvas->water;
 
   const Colors::Color *sprite[4][4] = {{FILL_, PRIME, PRIME, FILL_},
@@ -222,28 +220,26 @@ void drawRod(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
                                        {FILL_, DARK_, LIGHT, FILL_},
                                        {FILL_, DARK_, LIGHT, FILL_}};
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
-    for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-      blend(pos, (uint8_t *)sprite[j][i]);
+  for (uint8_t j = 0; j < 4; ++j)
+    blendLine(canvas->pixel(x, y + j), sprite[j]);
 }
 
 void drawBeam(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &, const Colors::Block *const color) {
+              const BlockState &, const Colors::Block *const color) {
   /* No top to make it look more continuous
    * |    |
    * | DL |
    * | DL |
    * | DL | */
-  uint8_t *pos = canvas->pixel(x + 1, y + 1);
-  for (uint8_t i = 1; i < 4; i++, pos = canvas->pixel(x + 1, y + i)) {
+  for (uint8_t i = 1; i < 4; i++) {
+    uint8_t *pos = canvas->pixel(x + 1, y + i);
     blend(pos, (uint8_t *)&color->dark);
     blend(pos + CHANSPERPIXEL, (uint8_t *)&color->light);
   }
 }
 
 void drawSlab(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &metadata, const Colors::Block *color) {
+              const BlockState &state, const Colors::Block *color) {
   /* This one has a hack to make it look like a gradual step up:
    * The second layer has primary colors to make the height difference
    * less obvious.
@@ -253,23 +249,14 @@ void drawSlab(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
    * |DDLL|    |    | */
 
   Colors::Block *fill = &canvas->air;
-  std::string waterlogged = "false", type = "bottom";
-
-  if (metadata.contains("Properties")) {
-    if (metadata["Properties"].contains("waterlogged"))
-      waterlogged = metadata["Properties"]["waterlogged"].get<string>();
-
-    if (metadata["Properties"].contains("type"))
-      type = metadata["Properties"]["type"].get<string>();
-  }
 
   // Draw a full block if it is a double slab
-  if (type == "double") {
-    drawFull(canvas, x, y, metadata, color);
+  if (state.slab == BlockState::SLAB_DOUBLE) {
+    drawFull(canvas, x, y, state, color);
     return;
   }
 
-  if (waterlogged == "true")
+  if (state.waterlogged)
     fill = &canvas->water;
 
   const Colors::Color *spriteTop[4][4] = {{PRIME, PRIME, PRIME, PRIME},
@@ -284,26 +271,22 @@ void drawSlab(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 
   const Colors::Color *(*target)[4][4] = &spriteBottom;
 
-  if (type == "top")
+  if (state.slab == BlockState::SLAB_TOP)
     target = &spriteTop;
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
-    for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-      blend(pos, (uint8_t *)(*target)[j][i]);
+  for (uint8_t j = 0; j < 4; ++j)
+    blendLine(canvas->pixel(x, y + j), (*target)[j]);
 }
 
 void drawWire(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &, const Colors::Block *color) {
+              const BlockState &, const Colors::Block *color) {
   uint8_t *pos = canvas->pixel(x + 1, y + 3);
   memcpy(pos, &color->primary, BYTESPERPIXEL);
   memcpy(pos + CHANSPERPIXEL, &color->primary, BYTESPERPIXEL);
 }
 
 void drawLog(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-             const nbt::NBT &metadata, const Colors::Block *color) {
-
-  string axis = "y";
+             const BlockState &state, const Colors::Block *color) {
   int sub = (float(color->primary.brightness()) / 323.0f + .21f);
 
   Colors::Color secondaryLight(color->secondary);
@@ -328,53 +311,32 @@ void drawLog(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 
   const Colors::Color *(*target)[4][4] = &spriteY;
 
-  if (metadata.contains("Properties") &&
-      metadata["Properties"].contains("axis")) {
-    axis = metadata["Properties"]["axis"].get<string>();
-
-    if (axis == "x") {
-      if (canvas->map.orientation == Map::NW ||
-          canvas->map.orientation == Map::SE)
-        target = &spriteZ;
-      else
-        target = &spriteX;
-    } else if (axis == "z") {
-      if (canvas->map.orientation == Map::NW ||
-          canvas->map.orientation == Map::SE)
-        target = &spriteX;
-      else
-        target = &spriteZ;
-    }
+  if (state.axis == BlockState::X) {
+    if (canvas->map.orientation == Map::NW ||
+        canvas->map.orientation == Map::SE)
+      target = &spriteZ;
+    else
+      target = &spriteX;
+  } else if (state.axis == BlockState::Z) {
+    if (canvas->map.orientation == Map::NW ||
+        canvas->map.orientation == Map::SE)
+      target = &spriteX;
+    else
+      target = &spriteZ;
   }
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
+  for (uint8_t j = 0; j < 4; ++j) {
+    uint8_t *pos = canvas->pixel(x, y + j);
     for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
       memcpy(pos, (*target)[j][i], BYTESPERPIXEL);
+  }
 }
 
 void drawStair(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-               const nbt::NBT &metadata, const Colors::Block *color) {
-
-  string facing = "north", half = "bottom", waterlogged = "false",
-         shape = "straight";
+               const BlockState &state, const Colors::Block *color) {
   Colors::Block *fill = &canvas->air;
 
-  if (metadata.contains("Properties")) {
-    if (metadata["Properties"].contains("facing"))
-      facing = metadata["Properties"]["facing"].get<string>();
-
-    if (metadata["Properties"].contains("half"))
-      half = metadata["Properties"]["half"].get<string>();
-
-    if (metadata["Properties"].contains("waterlogged"))
-      waterlogged = metadata["Properties"]["waterlogged"].get<string>();
-
-    if (metadata["Properties"].contains("shape"))
-      shape = metadata["Properties"]["shape"].get<string>();
-  }
-
-  if (waterlogged == "true")
+  if (state.waterlogged)
     fill = &canvas->water;
 
   const Colors::Color *spriteNorth[4][4] = {{FILL_, FILL_, PRIME, PRIME},
@@ -419,31 +381,26 @@ void drawStair(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 #undef spriteNorthEast
 #undef spriteSouthWest
 
-  std::map<std::string, int> directions = {
-      {"north", 0}, {"west", 1}, {"south", 2}, {"east", 3}};
-
-  int reference = (directions[facing] + 4 - canvas->map.orientation) % 4;
+  int reference = (state.facing + 4 - canvas->map.orientation) % 4;
 
-  if (shape == "straight") {
+  if (state.shape == BlockState::STRAIGHT) {
     target = (const Colors::Color *(*)[4][4])straight[reference];
-  } else if (shape == "inner_right") {
+  } else if (state.shape == BlockState::INNER_RIGHT) {
     target = (const Colors::Color *(*)[4][4])inner[reference];
-  } else if (shape == "inner_left") {
+  } else if (state.shape == BlockState::INNER_LEFT) {
     reference = (reference + 1) % 4;
     target = (const Colors::Color *(*)[4][4])inner[reference];
   }
 
-  if (half == "top")
+  if (state.half == BlockState::TOP)
     target = &spriteSouthEast;
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
-    for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-      blend(pos, (uint8_t *)(*target)[j][i]);
+  for (uint8_t j = 0; j < 4; ++j)
+    blendLine(canvas->pixel(x, y + j), (*target)[j]);
 }
 
 void drawFull(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &, const Colors::Block *color) {
+              const BlockState &, const Colors::Block *color) {
   // Sets canvas->pixels around x,y where A is the anchor
   // T = given color, D = darker, L = lighter
   // A T T T
@@ -456,22 +413,20 @@ void drawFull(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
                                        {DARK_, DARK_, LIGHT, LIGHT},
                                        {DARK_, DARK_, LIGHT, LIGHT}};
 
-  // Top row
-  uint8_t *pos = canvas->pixel(x, y);
-
   if (color->primary.ALPHA == 255) {
-    for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
+    for (uint8_t j = 0; j < 4; ++j) {
+      uint8_t *pos = canvas->pixel(x, y + j);
       for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
         memcpy(pos, sprite[j][i], BYTESPERPIXEL);
+    }
   } else {
-    for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
-      for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
-        blend(pos, (uint8_t *)sprite[j][i]);
+    for (uint8_t j = 0; j < 4; ++j)
+      blendLine(canvas->pixel(x, y + j), sprite[j]);
   }
 }
 
 void drawLamp(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
-              const nbt::NBT &metadata, const Colors::Block *color) {
+              const BlockState &state, const Colors::Block *color) {
   int sub = (float(color->primary.brightness()) / 323.0f + .21f);
 
   Colors::Color secondaryLight(color->secondary);
@@ -491,13 +446,12 @@ void drawLamp(IsometricCanvas *canvas, const uint32_t x, const uint32_t y,
 
   const Colors::Color *(*target)[4][4] = &off;
 
-  if (metadata.contains("Properties") &&
-      metadata["Properties"].contains("lit") &&
-      metadata["Properties"]["lit"].get<string>() == "true")
+  if (state.lit)
     target = &on;
 
-  uint8_t *pos = canvas->pixel(x, y);
-  for (uint8_t j = 0; j < 4; ++j, pos = canvas->pixel(x, y + j))
+  for (uint8_t j = 0; j < 4; ++j) {
+    uint8_t *pos = canvas->pixel(x, y + j);
     for (uint8_t i = 0; i < 4; ++i, pos += CHANSPERPIXEL)
       memcpy(pos, (*target)[j][i], BYTESPERPIXEL);
+  }
 }
@@ -0,0 +1,80 @@
+#include "./block_state.h"
+
+namespace {
+bool is_true(const nbt::View &value) {
+  return value.get_type() == nbt::tag_type::tag_string &&
+         value.get<std::string_view>() == "true";
+}
+} // namespace
+
+BlockState::BlockState(const nbt::View &entry) : BlockState() {
+  // Plants check this flag at the root of the entry, not in its properties
+  if (entry.contains("UnderWater"))
+    underwater = is_true(entry["UnderWater"]);
+
+  if (!entry.contains("Properties"))
+    return;
+
+  // Unknown values are left to their default
+  for (const auto &property : entry["Properties"]) {
+    const std::string_view name = property.get_name();
+
+    if (property.get_type() != nbt::tag_type::tag_string)
+      continue;
+
+    const std::string_view value = property.get<std::string_view>();
+
+    if (name == "facing") {
+      if (value == "west")
+        facing = WEST;
+      else if (value == "south")
+        facing = SOUTH;
+      else if (value == "east")
+        facing = EAST;
+    } else if (name == "half") {
+      if (value == "top")
+        half = TOP;
+    } else if (name == "axis") {
+      if (value == "x")
+        axis = X;
+      else if (value == "z")
+        axis = Z;
+    } else if (name == "shape") {
+      if (value == "inner_left")
+        shape = INNER_LEFT;
+      else if (value == "inner_right")
+        shape = INNER_RIGHT;
+      else if (value != "straight")
+        shape = OUTER;
+    } else if (name == "type") {
+      if (value == "top")
+        slab = SLAB_TOP;
+      else if (value == "double")
+        slab = SLAB_DOUBLE;
+    } else if (name == "lit") {
+      lit = is_true(property);
+    } else if (name == "waterlogged") {
+      waterlogged = is_true(property);
+    }
+  }
+}
+
+uint16_t BlockState::pack() const {
+  return facing | half << 2 | axis << 3 | shape << 5 | slab << 7 | lit << 9 |
+         underwater << 10 | waterlogged << 11;
+}
+
+BlockState BlockState::unpack(uint16_t bits) {
+  BlockState state;
+
+  state.facing = bits & 0x3;
+  state.half = (bits >> 2) & 0x1;
+  state.axis = (bits >> 3) & 0x3;
+  state.shape = (bits >> 5) & 0x3;
+  state.slab = (bits >> 7) & 0x3;
+  state.lit = (bits >> 9) & 0x1;
+  state.underwater = (bits >> 10) & 0x1;
+  state.waterlogged = (bits >> 11) & 0x1;
+
+  return state;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <nbt/view.hpp>
+
+// The properties of a block state used when drawing it. They are decoded from
+// the NBT data once per palette entry when a section is loaded, so drawing a
+// block never reads its NBT properties.
+struct BlockState {
+  // The facings are in the order the stair sprites are laid out in
+  enum Facing : uint8_t { NORTH = 0, WEST, SOUTH, EAST };
+  enum Half : uint8_t { BOTTOM = 0, TOP };
+  enum Axis : uint8_t { Y = 0, X, Z };
+  enum Shape : uint8_t { STRAIGHT = 0, INNER_LEFT, INNER_RIGHT, OUTER };
+  enum Slab : uint8_t { SLAB_BOTTOM = 0, SLAB_TOP, SLAB_DOUBLE };
+
+  uint16_t facing : 2;
+  uint16_t half : 1;
+  uint16_t axis : 2;
+  uint16_t shape : 2;
+  uint16_t slab : 2;
+  uint16_t lit : 1;
+  uint16_t underwater : 1;
+  uint16_t waterlogged : 1;
+
+  BlockState()
+      : facing(NORTH), half(BOTTOM), axis(Y), shape(STRAIGHT),
+        slab(SLAB_BOTTOM), lit(false), underwater(false),
+        waterlogged(false){};
+
+  // Decode the properties of a palette entry
+  explicit BlockState(const nbt::View &);
+
+  // The properties on 16 bits, to store them
+  uint16_t pack() const;
+  static BlockState unpack(uint16_t);
+};
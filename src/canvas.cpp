@@ -1,38 +1,83 @@
 #include "./canvas.h"
 #include "./VERSION"
 #include "./png.h"
+#include "./statistics.h"
+#include <set>
 
 Terrain::Data::ChunkCoordinates sum(Terrain::Data::ChunkCoordinates lhs,
                                     Terrain::Data::ChunkCoordinates rhs) {
   return {lhs.x + rhs.x, lhs.z + rhs.z};
 }
 
-size_t Canvas::_get_line(const uint8_t *data, uint8_t *buffer, size_t bufSize,
-                         uint64_t y) const {
-  const uint8_t *start = data + y * width() * BYTESPERPIXEL;
-  uint8_t tmpPixel[4];
+// Blend `count` pixels of a line under the pixels in `buffer`
+void overlay(const uint8_t *line, uint8_t *buffer, size_t count) {
+  blend_under(buffer, line, count);
+}
 
-  if (y > height())
+void SparseBuffer::resize(size_t _width, size_t _height) {
+  width = _width;
+  height = _height;
+  columns = width / block + (width % block ? 1 : 0);
+  rows = height / block + (height % block ? 1 : 0);
+
+  blocks.clear();
+  blocks.resize(columns * rows);
+}
+
+const uint8_t *SparseBuffer::pixel(size_t x, size_t y) const {
+  if (x >= width || y >= height)
+    return nullptr;
+
+  const std::unique_ptr<uint8_t[]> &pixels =
+      blocks[(y / block) * columns + x / block];
+
+  if (!pixels)
+    return nullptr;
+
+  return &pixels[((y % block) * block + x % block) * BYTESPERPIXEL];
+}
+
+size_t SparseBuffer::allocated() const {
+  size_t count = 0;
+
+  for (const auto &pixels : blocks)
+    count += bool(pixels);
+
+  return count;
+}
+
+size_t Canvas::_get_line(const PackedImage &data, uint8_t *buffer,
+                         size_t bufSize, uint64_t y) const {
+  if (y >= height())
     return 0;
 
   size_t boundary = std::min(bufSize, width());
 
-  for (size_t i = 0; i < boundary; i++) {
-    const uint8_t *data = start + i * BYTESPERPIXEL;
+  data.blend(y, buffer, boundary);
 
-    // If the subCanvas is empty here, or the canvas already has a pixel
-    if (!data[3] || (buffer + i * BYTESPERPIXEL)[3] == 0xff)
-      continue;
+  return boundary;
+}
+
+size_t Canvas::_get_line(const SparseBuffer &data, uint8_t *buffer,
+                         size_t bufSize, uint64_t y) const {
+  if (y > height())
+    return 0;
+
+  size_t boundary = std::min(bufSize, width());
 
-    memcpy(tmpPixel, buffer + i * BYTESPERPIXEL, BYTESPERPIXEL);
-    memcpy(buffer + i * BYTESPERPIXEL, data, BYTESPERPIXEL);
-    blend(buffer + i * BYTESPERPIXEL, tmpPixel);
+  // The blocks never drawn in are left out
+  for (size_t x = 0; x < boundary; x += SparseBuffer::block) {
+    const uint8_t *line = data.pixel(x, y);
+
+    if (line)
+      overlay(line, buffer + x * BYTESPERPIXEL,
+              std::min(SparseBuffer::block, boundary - x));
   }
 
   return boundary;
 }
 
-std::vector<uint8_t> read_bytes;
+thread_local std::vector<uint8_t> read_bytes;
 
 size_t Canvas::_get_line(PNG::PNGReader *data, uint8_t *buffer, size_t bufSize,
                          uint64_t y) const {
@@ -44,20 +89,9 @@ size_t Canvas::_get_line(PNG::PNGReader *data, uint8_t *buffer, size_t bufSize,
   size_t requested = std::min(bufSize, width() * data->_bytesPerPixel);
 
   read_bytes.reserve(requested);
-  uint8_t tmpPixel[4];
   data->getLine(&read_bytes[0], requested);
 
-  for (size_t i = 0; i < width(); i++) {
-    const uint8_t *read_pixel = &read_bytes[0] + i * BYTESPERPIXEL;
-
-    // If the subCanvas is empty here, or the canvas already has a pixel
-    if (!read_pixel[3] || (buffer + i * BYTESPERPIXEL)[3] == 0xff)
-      continue;
-
-    memcpy(tmpPixel, buffer + i * BYTESPERPIXEL, BYTESPERPIXEL);
-    memcpy(buffer + i * BYTESPERPIXEL, read_pixel, BYTESPERPIXEL);
-    blend(buffer + i * BYTESPERPIXEL, tmpPixel);
-  }
+  overlay(&read_bytes[0], buffer, width());
 
   return requested;
 }
@@ -81,108 +115,266 @@ size_t Canvas::_get_line(const std::vector<Canvas> &fragments, uint8_t *buffer,
 
 bool Canvas::save(const std::filesystem::path file, const uint8_t padding,
                   Progress::Callback notify) const {
-  Progress::Status progress(height(), notify, Progress::COMPOSING);
-
-  // Write the buffer to file
-  PNG::PNGWriter output(file);
+  const size_t size = width() * BYTESPERPIXEL;
+  const size_t rows = height() + 2 * padding;
 
-  output.set_width(width());
-  output.set_height(height());
-  output.set_padding(padding);
+  Progress::Status progress(rows, notify, Progress::COMPOSING);
 
   PNG::Comments comments = {
       {"Software", VERSION},
       {"Coordinates", map.to_string()},
   };
 
-  output.set_text(comments);
+  // Write the buffer to file. The lines are composed here in batches, and
+  // compressed by the writer on all the threads available.
+  PNG::ParallelWriter output(file, width() + 2 * padding,
+                             height() + 2 * padding, comments);
 
-  size_t size = width() * BYTESPERPIXEL;
-  uint8_t *buffer = output.getBuffer();
+  if (!output.is_open())
+    return false;
 
-  for (size_t y = 0; y < height(); y++) {
-    memset(buffer, 0, size);
-    getLine(buffer, size, y);
-    output.writeLine();
+  for (size_t y = 0; y < rows;) {
+    const size_t count = std::min(output.batch(), rows - y);
+
+    // The padding is left blank
+    for (size_t i = 0; i < count; i++)
+      if (y + i >= padding && y + i < height() + padding)
+        getLine(output.row(i) + padding * BYTESPERPIXEL, size,
+                y + i - padding);
 
-    if (y && !(y % 100))
-      progress.increment(100);
+    if (!output.commit(count))
+      return false;
+
+    y += count;
+    progress.increment(count);
   }
 
-  progress.increment(100);
+  return output.close();
+}
+
+void downsample(const uint8_t *source, size_t width, uint8_t *destination) {
+  const uint8_t *top = source, *bottom = source + width * BYTESPERPIXEL;
 
-  return true;
+  for (size_t x = 0; x + 1 < width; x += 2) {
+    const uint8_t *block[4] = {
+        top + x * BYTESPERPIXEL,
+        top + (x + 1) * BYTESPERPIXEL,
+        bottom + x * BYTESPERPIXEL,
+        bottom + (x + 1) * BYTESPERPIXEL,
+    };
+
+    uint32_t alpha = 0, color[3] = {0, 0, 0};
+
+    for (const uint8_t *pixel : block) {
+      alpha += pixel[3];
+      for (uint8_t channel = 0; channel < 3; channel++)
+        color[channel] += pixel[channel] * pixel[3];
+    }
+
+    uint8_t *pixel = destination + (x / 2) * BYTESPERPIXEL;
+
+    if (!alpha) {
+      memset(pixel, 0, BYTESPERPIXEL);
+      continue;
+    }
+
+    for (uint8_t channel = 0; channel < 3; channel++)
+      pixel[channel] = (color[channel] + alpha / 2) / alpha;
+    pixel[3] = (alpha + 2) / 4;
+  }
 }
 
-bool Canvas::tile(const fs::path file, uint16_t tilesize,
-                  Progress::Callback notify) const {
+bool Canvas::tile(const fs::path file, uint16_t tilesize, uint8_t levels,
+                  Progress::Callback notify, const TileFilter &filter) const {
   Progress::Status progress(height(), notify, Progress::TILING);
 
-  uint16_t tilesX = width() / tilesize + (width() % tilesize ? 1 : 0);
-  uint16_t tilesY = height() / tilesize + (height() % tilesize ? 1 : 0);
+  // A row of tiles of a level. Only one row is kept in memory per level: the
+  // rows of a level are folded into the level above as they are written, two
+  // of them filling a row of the coarser level.
+  struct Level {
+    size_t tilesX, tilesY;
+    size_t row;   // Index of the row held in the band
+    bool pending; // The band holds pixels not written yet
+    std::vector<uint8_t> band;
+    std::vector<bool> selected; // The tiles to write
+
+    size_t stride(uint16_t tilesize) const {
+      return tilesX * tilesize * BYTESPERPIXEL;
+    }
 
-  size_t size = tilesX * tilesize * BYTESPERPIXEL;
-  std::vector<uint8_t> buffer;
-  buffer.resize(size);
+    // Whether one of the 2x2 tiles from (x, y) is selected
+    bool covers(size_t x, size_t y) const {
+      for (size_t j = y; j < std::min(y + 2, tilesY); j++)
+        for (size_t i = x; i < std::min(x + 2, tilesX); i++)
+          if (selected[j * tilesX + i])
+            return true;
+      return false;
+    }
+  };
+
+  std::vector<Level> pyramid(levels + 1);
+
+  for (uint8_t z = 0; z <= levels; z++) {
+    Level &level = pyramid[z];
+    const size_t sizeX = z ? pyramid[z - 1].tilesX : width(),
+                 sizeY = z ? pyramid[z - 1].tilesY : height(),
+                 scale = z ? 2 : tilesize;
+
+    level.tilesX = sizeX / scale + (sizeX % scale ? 1 : 0);
+    level.tilesY = sizeY / scale + (sizeY % scale ? 1 : 0);
+    level.row = 0;
+    level.pending = false;
+    level.band.resize(level.stride(tilesize) * tilesize);
+    level.selected.resize(level.tilesX * level.tilesY, !filter);
+
+    // A tile is written if any of the tiles it is made of is
+    for (size_t y = 0; filter && y < level.tilesY; y++)
+      for (size_t x = 0; x < level.tilesX; x++)
+        level.selected[y * level.tilesX + x] =
+            z ? pyramid[z - 1].covers(2 * x, 2 * y) : filter(x, y);
+  }
+
+  auto directory = [&](uint8_t z, size_t x) {
+    return levels ? file / std::to_string(z) / std::to_string(x)
+                  : file / std::to_string(x);
+  };
 
-  std::vector<PNG::PNGWriter> row;
   std::error_code dir_creation_error;
 
-  for (uint16_t x = 0; x < tilesX; x++) {
-    // Create all the directories needed to output the tiles
-    fs::path row_dir = file / std::to_string(x);
-    fs::create_directories(row_dir, dir_creation_error);
-    if (dir_creation_error) {
-      logger::error("Failed to create directory {}: {}",
-                    row_dir.string().c_str(), dir_creation_error.message());
-      return false;
+  for (uint8_t z = 0; z <= levels; z++) {
+    for (size_t x = 0; x < pyramid[z].tilesX; x++) {
+      // Create all the directories needed to output the tiles
+      fs::path row_dir = directory(z, x);
+      fs::create_directories(row_dir, dir_creation_error);
+      if (dir_creation_error) {
+        logger::error("Failed to create directory {}: {}",
+                      row_dir.string().c_str(), dir_creation_error.message());
+        return false;
+      }
     }
   }
 
-  for (uint16_t y = 0; y < tilesY; y++) {
-    // Initialize the PNG files to output to and put them in the row vector
-    progress.increment(tilesize);
+  // Encode the tiles of the band of a level, one tile per thread
+  auto write = [&](const Level &level, uint8_t z) {
+    const size_t stride = level.stride(tilesize);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int x = 0; x < int(level.tilesX); x++) {
+      if (!level.selected[level.row * level.tilesX + x])
+        continue;
 
-    for (uint16_t x = 0; x < tilesX; x++) {
-      auto tile =
-          PNG::PNGWriter(fmt::format("{}/{}/{}.png", file.string(), x, y));
+      auto tile = PNG::PNGWriter(directory(z, x) /
+                                 fmt::format("{}.png", level.row));
       tile.set_padding(0);
       tile.set_width(tilesize);
       tile.set_height(tilesize);
+
       PNG::Comments comments = {
           {"Software", VERSION},
           {"Coordinates", map.to_string()},
-          {"Tile", fmt::format("{}.{}", x, y)},
+          {"Tile", fmt::format("{}.{}", x, level.row)},
       };
 
+      if (levels)
+        comments["Zoom"] = std::to_string(z);
+
       tile.set_text(comments);
-      row.emplace_back(std::move(tile));
+
+      for (uint16_t line = 0; line < tilesize; line++) {
+        memcpy(tile.getBuffer(),
+               &level.band[line * stride + x * tilesize * BYTESPERPIXEL],
+               tilesize * BYTESPERPIXEL);
+        tile.writeLine();
+      }
     }
+  };
 
-    // For the next tilesize lines
-    for (uint16_t line = 0; line < tilesize; line++) {
-      memset(&buffer[0], 0, size);
+  // Write the band of level `z`, and shrink it in the band of the next level.
+  // Once both halves of that band are filled, it is written in turn.
+  auto flush = [&](uint8_t z) {
+    for (; z <= levels; z++) {
+      Level &level = pyramid[z];
+      const size_t row = level.row;
 
-      getLine(&buffer[0], size, y * tilesize + line);
+      write(level, z);
 
-      for (uint16_t x = 0; x < tilesX; x++) {
-        auto output_buffer = row[x].getBuffer();
-        memcpy(output_buffer, &buffer[x * tilesize * BYTESPERPIXEL],
-               tilesize * BYTESPERPIXEL);
-        row[x].writeLine();
+      if (z < levels) {
+        Level &next = pyramid[z + 1];
+        const size_t stride = level.stride(tilesize),
+                     offset = (row & 1) * tilesize / 2;
+
+        for (uint16_t line = 0; line + 1 < tilesize; line += 2)
+          downsample(&level.band[line * stride], level.tilesX * tilesize,
+                     &next.band[(offset + line / 2) * next.stride(tilesize)]);
+
+        next.pending = true;
       }
+
+      std::fill(level.band.begin(), level.band.end(), 0);
+      level.pending = false;
+      level.row++;
+
+      if (!(row & 1))
+        break;
     }
+  };
+
+  Level &base = pyramid[0];
+  const size_t size = base.stride(tilesize);
+
+  for (size_t y = 0; y < base.tilesY; y++) {
+    // The lines are composed in order, as images can only be read this way
+    for (uint16_t line = 0; line < tilesize; line++)
+      if (y * tilesize + line < height())
+        getLine(&base.band[line * size], size, y * tilesize + line);
 
-    // Delete all the PNG files, triggering close
-    row.clear();
+    flush(0);
+    progress.increment(tilesize);
   }
 
+  // Write the coarser levels left with half a band
+  for (uint8_t z = 1; z <= levels; z++)
+    if (pyramid[z].pending)
+      flush(z);
+
   return true;
 }
 
+PackedCanvas::PackedCanvas(const Canvas &canvas) {
+  map = canvas.map;
+  type = PACKED;
+  drawing.packed_buffer = new PackedImage(width(), height());
+
+  std::vector<uint8_t> line(width() * BYTESPERPIXEL);
+
+  for (size_t y = 0; y < height(); y++) {
+    std::fill(line.begin(), line.end(), 0);
+    canvas.getLine(line.data(), line.size(), y);
+    drawing.packed_buffer->add(line.data());
+  }
+}
+
+PackedCanvas::PackedCanvas(const World::Coordinates &map,
+                           const fs::path &file) {
+  type = PACKED;
+  drawing.packed_buffer = new PackedImage(file);
+
+  const PackedImage &image = *drawing.packed_buffer;
+  this->map = map;
+
+  if (!image.valid() || image.width != width() || image.height != height()) {
+    drawing.destroy(type);
+    drawing.null_buffer = 0;
+    type = EMPTY;
+  }
+}
+
 std::string Canvas::to_string() const {
   std::map<Canvas::BufferType, std::string> names = {
-      {Canvas::BufferType::BYTES, "Byte"},
+      {Canvas::BufferType::SPARSE, "Sparse"},
+      {Canvas::BufferType::PACKED, "Packed"},
       {Canvas::BufferType::CANVAS, "Canvas"},
       {Canvas::BufferType::IMAGE, "Image"},
       {Canvas::BufferType::EMPTY, "Void"},
@@ -203,9 +395,63 @@ std::string Canvas::to_string() const {
   return description;
 }
 
-void IsometricCanvas::setColors(const Colors::Palette &colors) {
+// Precompute the shading profile. The values are arbitrary, and will go
+// through Colors::Color.modcolor further down the code. The 255 array
+// represents the entire world height. This profile is linear, going from -100
+// at height 0 to 100 at height 255. This replaced a convoluted formula that did
+// a much better job of higlighting overground terrain, but would look weird in
+// other dimensions.
+// Legacy formula: ((100.0f / (1.0f + exp(- (1.3f * (float(y) *
+// MIN(g_MapsizeY, 200) / g_MapsizeY) / 16.0f) + 6.0f))) - 91)
+float shadingProfile(int y) {
+  return -100 + 200 * float(y) / mcmap::constants::terrain_height;
+}
+
+ColorTables::ColorTables(const Colors::Index &index, bool shading,
+                         bool lighting)
+    : blocks(index.size()) {
+  using namespace mcmap::constants;
+
+  if (shading) {
+    shaded.reserve(blocks * terrain_height);
+
+    for (id_t id = 0; id < blocks; id++)
+      for (int y = 0; y < terrain_height; y++)
+        shaded.push_back(index.block(id)->shade(shadingProfile(y)));
+  }
+
+  if (lighting) {
+    emitting.reserve(blocks * 16);
+    faces.reserve(blocks * 16);
+
+    for (id_t id = 0; id < blocks; id++) {
+      const Colors::Block &block = *index.block(id);
+
+      for (uint8_t light = 0; light < 16; light++) {
+        emitting.push_back(
+            block.shade(lighting_dark + lighting_delta * light));
+
+        // Same formula as the lighting in IsometricCanvas::renderBlock
+        Faces lit = {block.primary, block.secondary, block.light, block.dark};
+        lit.primary.modColor((lighting_dark + lighting_delta * light) *
+                             (block.primary.brightness() / 323.0f + .21f));
+        lit.secondary.modColor((lighting_dark + lighting_delta * light) *
+                               (block.secondary.brightness() / 323.0f + .21f));
+        lit.light.modColor((lighting_dark + lighting_delta * light) *
+                           (block.light.brightness() / 323.0f + .21f));
+        lit.dark.modColor((lighting_dark + lighting_delta * light) *
+                          (block.dark.brightness() / 323.0f + .21f));
+        faces.push_back(lit);
+      }
+    }
+  }
+}
+
+void IsometricCanvas::setColors(const Colors::Palette &colors,
+                                const ColorTables *precomputed) {
   // Setting and pre-caching colors
   palette = colors;
+  tables = precomputed;
 
   auto beamColor = colors.find("mcmap:beacon_beam");
   if (beamColor != colors.end())
@@ -222,17 +468,8 @@ void IsometricCanvas::setColors(const Colors::Palette &colors) {
   // Set to true to use later on
   shading = lighting = false;
 
-  // Precompute the shading profile. The values are arbitrary, and will go
-  // through Colors::Color.modcolor further down the code. The 255 array
-  // represents the entire world height. This profile is linear, going from
-  // -100 at height 0 to 100 at height 255. This replaced a convoluted formula
-  // that did a much better job of higlighting overground terrain, but would
-  // look weird in other dimensions.
-  // Legacy formula: ((100.0f / (1.0f + exp(- (1.3f * (float(y) *
-  // MIN(g_MapsizeY, 200) / g_MapsizeY) / 16.0f) + 6.0f))) - 91)
   for (int y = 0; y < mcmap::constants::terrain_height; ++y)
-    brightnessLookup[y] =
-        -100 + 200 * float(y) / mcmap::constants::terrain_height;
+    brightnessLookup[y] = shadingProfile(y);
 }
 
 void IsometricCanvas::setMap(const World::Coordinates &_map) {
@@ -274,8 +511,44 @@ void IsometricCanvas::setMap(const World::Coordinates &_map) {
 
   height = sizeX + sizeZ + (map.maxY - map.minY + 1) * BLOCKHEIGHT - 1;
 
-  size_t size = size_t((width + 1) * (height + 1) * BYTESPERPIXEL);
-  drawing.bytes_buffer->resize(size, 0);
+  drawing.sparse_buffer->resize(width, height + 1);
+}
+
+size_t IsometricCanvas::footprint(const World::Coordinates &map) {
+  int64_t sizeX = map.sizeX(), sizeZ = map.sizeZ();
+  const int64_t layers = (map.maxY - map.minY + 1) * BLOCKHEIGHT;
+
+  if (map.orientation == Map::NE || map.orientation == Map::SW)
+    std::swap(sizeX, sizeZ);
+
+  // The size of the buffer, as set in `setMap`
+  const int64_t width = (sizeX + sizeZ) * 2, height = sizeX + sizeZ + layers;
+
+  // The view is a hexagon: the top of the terrain is a diamond with its
+  // corners at (2 * sizeZ, 0), (0, sizeZ), (width, sizeX) and (2 * sizeX,
+  // sizeX + sizeZ), stretched down by the layers. The lines are counted from
+  // their left to their right edge, with a margin for the sprites.
+  const int64_t margin = 2 * spriteWidth, block = SparseBuffer::block;
+  size_t blocks = 0;
+
+  for (int64_t row = 0; row * block < height; row++) {
+    int64_t first = width - 1, last = 0;
+
+    for (int64_t y = row * block; y < std::min(height, (row + 1) * block);
+         y++) {
+      const int64_t left = std::max(2 * (sizeZ - y), 2 * (y - layers - sizeZ)),
+                    right = std::min(2 * (sizeZ + y),
+                                     width - 2 * (y - layers - sizeX));
+
+      first = std::min(first, std::max(int64_t(0), left - margin));
+      last = std::max(last, std::min(width - 1, right + margin));
+    }
+
+    if (first <= last)
+      blocks += last / block - first / block + 1;
+  }
+
+  return blocks * block * block * BYTESPERPIXEL;
 }
 
 // ____                     _
@@ -323,6 +596,28 @@ void IsometricCanvas::renderTerrain(Terrain::Data &world) {
   if (map.orientation == Map::NE || map.orientation == Map::SW)
     std::swap(nXChunks, nZChunks);
 
+  // Give the terrain the order in which the chunks will be accessed, to get
+  // them decoded while the previous ones are drawn
+  std::vector<Chunk::coordinates> order;
+  order.reserve(nXChunks * nZChunks * (lighting ? 3 : 1));
+
+  for (int32_t x = 0; x < int32_t(nXChunks); x++) {
+    for (int32_t z = 0; z < int32_t(nZChunks); z++) {
+      int32_t worldX = x, worldZ = z;
+      orientChunk(worldX, worldZ);
+
+      const Chunk::coordinates position = {worldX, worldZ};
+      order.push_back(position);
+
+      if (lighting) {
+        order.push_back(position + left_in(map.orientation));
+        order.push_back(position + right_in(map.orientation));
+      }
+    }
+  }
+
+  world.schedule(order);
+
   // world is supposed to have the SAME set of coordinates as the canvas
   for (chunkX = 0; chunkX < nXChunks; chunkX++)
     for (chunkZ = 0; chunkZ < nZChunks; chunkZ++)
@@ -414,6 +709,30 @@ void IsometricCanvas::renderSection(const Section &section) {
   // We need the real position of the section for bounds checking
   orientChunk(worldX, worldZ);
 
+  auto drawn = [this](int px, int pz) {
+    // If we want a circular render, ignore everything outside the radius.
+    if (map.circleDefined()) {
+      int dist = (px - map.cenX) * (px - map.cenX) +
+                 (pz - map.cenZ) * (pz - map.cenZ);
+      if (dist > map.rsqrd)
+        return false;
+    }
+
+    return !(px > map.maxX || px < map.minX || pz > map.maxZ || pz < map.minZ);
+  };
+
+  // A block is hidden when the three blocks drawn over its sprite occlude it:
+  // the one on top, and the ones in front of its left and right faces. Those
+  // are drawn later, so skipping the hidden block leaves the image unchanged.
+  const Chunk::coordinates left = left_in(map.orientation),
+                           right = right_in(map.orientation);
+
+  // The block on top of the last layer is in the next section, if present
+  const Chunk::section_array_t::const_iterator above = section_up();
+  const bool above_drawn = above != empty_section.begin() &&
+                           above->Y == section.Y + 1 &&
+                           ((section.Y + 1) << 4) <= map.maxY;
+
   // Main drawing loop, for every block of the section
   for (uint8_t x = 0; x < 16; x++) {
     for (uint8_t z = 0; z < 16; z++) {
@@ -425,19 +744,23 @@ void IsometricCanvas::renderSection(const Section &section) {
       int px = (worldX << 4) + orientedX;
       int pz = (worldZ << 4) + orientedZ;
 
-      // If we want a circular render, ignore everything outside the radius.
-      if (map.circleDefined()) {
-        int dist = (px - map.cenX) * (px - map.cenX) +
-                   (pz - map.cenZ) * (pz - map.cenZ);
-        if (dist > map.rsqrd) {
-          continue;
-        }
-      }
-
-      // If we are oob, skip the line
-      if (px > map.maxX || px < map.minX || pz > map.maxZ || pz < map.minZ)
+      // If we are oob or outside of the circle, skip the line
+      if (!drawn(px, pz))
         continue;
 
+      // The blocks in front of the column must be drawn to hide anything; the
+      // columns on the edges of the chunk are never culled, as their
+      // neighbours are in another chunk
+      const Chunk::coordinates column = {orientedX, orientedZ};
+      const Chunk::coordinates front_left = column + left,
+                               front_right = column + right;
+
+      const bool enclosed =
+          front_left.x >= 0 && front_left.x < 16 && front_left.z >= 0 &&
+          front_left.z < 16 && front_right.x >= 0 && front_right.x < 16 &&
+          front_right.z >= 0 && front_right.z < 16 &&
+          drawn(px + left.x, pz + left.z) && drawn(px + right.x, pz + right.z);
+
       for (uint8_t index = 0; index < beamNo; index++) {
         if (beams[index].column(orientedX, orientedZ)) {
           currentBeam = index;
@@ -451,11 +774,22 @@ void IsometricCanvas::renderSection(const Section &section) {
       for (y = minY; y < maxY; y++) {
         if (beamColumn)
           renderBlock(beams[currentBeam].color, (chunkX << 4) + x,
-                      (chunkZ << 4) + z, (section.Y << 4) + y, nbt::NBT());
-
-        renderBlock(section.color_at(orientedX, y, orientedZ),
-                    (chunkX << 4) + x, (chunkZ << 4) + z, (section.Y << 4) + y,
-                    section.state_at(orientedX, y, orientedZ));
+                      (chunkZ << 4) + z, (section.Y << 4) + y, BlockState());
+
+        const bool hidden =
+            enclosed &&
+            section.occludes(front_left.x, y, front_left.z) &&
+            section.occludes(front_right.x, y, front_right.z) &&
+            (y + 1 < maxY ? section.occludes(orientedX, y + 1, orientedZ)
+                          : y == 15 && above_drawn &&
+                                above->occludes(orientedX, 0, orientedZ));
+
+        if (!hidden)
+          renderBlock(section.color_at(orientedX, y, orientedZ),
+                      (chunkX << 4) + x, (chunkZ << 4) + z,
+                      (section.Y << 4) + y,
+                      section.state_at(orientedX, y, orientedZ),
+                      section.id_at(orientedX, y, orientedZ));
 
         if (section.block_at(orientedX, y, orientedZ) == section.beaconIndex) {
           beams[beamNo++] = Beam(orientedX, orientedZ, &beaconBeam);
@@ -501,7 +835,7 @@ void IsometricCanvas::renderBeamSection(const int64_t xPos, const int64_t zPos,
       for (uint8_t y = minY; y < maxY; y++) {
         if (beamColumn)
           renderBlock(beams[currentBeam].color, (xPos << 4) + x,
-                      (zPos << 4) + z, (yPos << 4) + y, nbt::NBT());
+                      (zPos << 4) + z, (yPos << 4) + y, BlockState());
       }
     }
   }
@@ -528,7 +862,8 @@ drawer blockRenderers[] = {
 
 inline void IsometricCanvas::renderBlock(const Colors::Block *color, uint32_t x,
                                          uint32_t z, const int32_t y,
-                                         const nbt::NBT &metadata) {
+                                         const BlockState &state,
+                                         const Colors::Index::id_t id) {
   // Pointer to the color to use, and local color buffer if changes are due
   const Colors::Block *colorPtr = color;
   Colors::Block localColor;
@@ -623,9 +958,12 @@ inline void IsometricCanvas::renderBlock(const Colors::Block *color, uint32_t x,
       localColor = localColor.shade(mcmap::constants::lighting_bright);
     } else if (self_light) {
       // For light-emitting blocks, no need to check left or right
-      localColor =
-          localColor.shade(mcmap::constants::lighting_dark +
-                           mcmap::constants::lighting_delta * self_light);
+      if (tables && tables->lights(id))
+        localColor = tables->emit(id, self_light);
+      else
+        localColor =
+            localColor.shade(mcmap::constants::lighting_dark +
+                             mcmap::constants::lighting_delta * self_light);
     } else {
       // For the rest, we calculate the coordinates of the top, left and right
       // adjacent blocks, lookup their light and modify the color accordingly
@@ -665,28 +1003,40 @@ inline void IsometricCanvas::renderBlock(const Colors::Block *color, uint32_t x,
           right_coords.z);
 
       // Modify the block accordingdly
-      localColor.dark.modColor((mcmap::constants::lighting_dark +
-                                mcmap::constants::lighting_delta * left_light) *
-                               (localColor.dark.brightness() / 323.0f + .21f));
-
-      localColor.light.modColor(
-          (mcmap::constants::lighting_dark +
-           mcmap::constants::lighting_delta * right_light) *
-          (localColor.light.brightness() / 323.0f + .21f));
-
-      localColor.secondary.modColor(
-          (mcmap::constants::lighting_dark +
-           mcmap::constants::lighting_delta * top_light) *
-          (localColor.secondary.brightness() / 323.0f + .21f));
-
-      localColor.primary.modColor(
-          (mcmap::constants::lighting_dark +
-           mcmap::constants::lighting_delta * top_light) *
-          (localColor.primary.brightness() / 323.0f + .21f));
+      if (tables && tables->lights(id)) {
+        localColor.dark = tables->lit(id, left_light).dark;
+        localColor.light = tables->lit(id, right_light).light;
+        localColor.secondary = tables->lit(id, top_light).secondary;
+        localColor.primary = tables->lit(id, top_light).primary;
+      } else {
+        localColor.dark.modColor(
+            (mcmap::constants::lighting_dark +
+             mcmap::constants::lighting_delta * left_light) *
+            (localColor.dark.brightness() / 323.0f + .21f));
+
+        localColor.light.modColor(
+            (mcmap::constants::lighting_dark +
+             mcmap::constants::lighting_delta * right_light) *
+            (localColor.light.brightness() / 323.0f + .21f));
+
+        localColor.secondary.modColor(
+            (mcmap::constants::lighting_dark +
+             mcmap::constants::lighting_delta * top_light) *
+            (localColor.secondary.brightness() / 323.0f + .21f));
+
+        localColor.primary.modColor(
+            (mcmap::constants::lighting_dark +
+             mcmap::constants::lighting_delta * top_light) *
+            (localColor.primary.brightness() / 323.0f + .21f));
+      }
     }
   }
 
-  if (shading) {
+  if (shading && !lighting && tables && tables->shades(id)) {
+    // The tables only hold the shading of the original colors; lit colors are
+    // shaded below
+    colorPtr = &tables->shade(id, y);
+  } else if (shading) {
     // Copy the color if it has not been done before
     if (!lighting) {
       localColor = *colorPtr;
@@ -698,7 +1048,44 @@ inline void IsometricCanvas::renderBlock(const Colors::Block *color, uint32_t x,
   }
 
   // Then call the function registered with the block's type
-  blockRenderers[colorPtr->type](this, bmpPosX, bmpPosY, metadata, colorPtr);
+  if (bmpPosX % SparseBuffer::block + spriteWidth <= SparseBuffer::block) {
+    blockRenderers[colorPtr->type](this, bmpPosX, bmpPosY, state, colorPtr);
+    return;
+  }
+
+  // The sprite covers two blocks of the buffer, its lines are not contiguous.
+  // It is drawn aside, with the pixels already there, blocks never drawn in
+  // being transparent.
+  SparseBuffer &buffer = *drawing.sparse_buffer;
+
+  for (uint8_t j = 0; j < spriteHeight; j++)
+    for (uint8_t i = 0; i < spriteWidth; i++) {
+      const uint8_t *drawn = buffer.pixel(bmpPosX + i, bmpPosY + j);
+      uint8_t *copy = &sprite[(j * spriteWidth + i) * BYTESPERPIXEL];
+
+      if (drawn)
+        memcpy(copy, drawn, BYTESPERPIXEL);
+      else
+        memset(copy, 0, BYTESPERPIXEL);
+    }
+
+  spriteX = bmpPosX;
+  spriteY = bmpPosY;
+  straddling = true;
+  blockRenderers[colorPtr->type](this, bmpPosX, bmpPosY, state, colorPtr);
+  straddling = false;
+
+  // Pixels left transparent do not allocate the blocks never drawn in
+  const uint8_t transparent[BYTESPERPIXEL] = {};
+
+  for (uint8_t j = 0; j < spriteHeight; j++)
+    for (uint8_t i = 0; i < spriteWidth; i++) {
+      const uint8_t *copy = &sprite[(j * spriteWidth + i) * BYTESPERPIXEL];
+
+      if (buffer.pixel(bmpPosX + i, bmpPosY + j) ||
+          memcmp(copy, transparent, BYTESPERPIXEL))
+        memcpy(buffer.write(bmpPosX + i, bmpPosY + j), copy, BYTESPERPIXEL);
+    }
 }
 
 const Colors::Block *IsometricCanvas::nextBlock() {
@@ -727,18 +1114,17 @@ IsometricCanvas::section_left(const Terrain::Data &terrain) {
   Chunk::coordinates left =
       Chunk::coordinates({worldX, worldZ}) + left_in(map.orientation);
 
-  const auto &chunk_left = terrain.chunks.find({left.x, left.z});
+  const Chunk *chunk_left = terrain.chunks.find(left);
 
-  if (chunk_left == terrain.chunks.end())
+  if (!chunk_left)
     return empty_section.begin();
 
-  for (Chunk::section_array_t::const_iterator section =
-           chunk_left->second.sections.begin();
-       section != chunk_left->second.sections.end(); section++)
-    if (section->Y == current_section->Y)
-      return section;
+  auto section = chunk_left->section(current_section->Y);
+
+  if (section == chunk_left->sections.end())
+    return empty_section.begin();
 
-  return empty_section.begin();
+  return section;
 }
 
 IsometricCanvas::Chunk::section_array_t::const_iterator
@@ -749,18 +1135,17 @@ IsometricCanvas::section_right(const Terrain::Data &terrain) {
   Chunk::coordinates right =
       Chunk::coordinates({worldX, worldZ}) + right_in(map.orientation);
 
-  const auto &chunk_right = terrain.chunks.find({right.x, right.z});
+  const Chunk *chunk_right = terrain.chunks.find(right);
 
-  if (chunk_right == terrain.chunks.end())
+  if (!chunk_right)
     return empty_section.begin();
 
-  for (Chunk::section_array_t::const_iterator section =
-           chunk_right->second.sections.begin();
-       section != chunk_right->second.sections.end(); section++)
-    if (section->Y == current_section->Y)
-      return section;
+  auto section = chunk_right->section(current_section->Y);
+
+  if (section == chunk_right->sections.end())
+    return empty_section.begin();
 
-  return empty_section.begin();
+  return section;
 }
 
 bool compare(const Canvas &p1, const Canvas &p2) {
@@ -782,6 +1167,73 @@ CompositeCanvas::CompositeCanvas(std::vector<Canvas> &&parts)
   // avoid overwriting too many blocks.
   std::sort(drawing.canvas_buffer->begin(), drawing.canvas_buffer->end(),
             compare);
+
+  const std::vector<Canvas> &fragments = *drawing.canvas_buffer;
+
+  // Every sub-canvas enters the lines at its first line, and leaves them after
+  // its last; the events are sorted by line
+  std::vector<std::pair<uint64_t, uint32_t>> entering, leaving;
+
+  for (size_t i = 0; i < fragments.size(); i++) {
+    const Canvas &fragment = fragments[i];
+
+    if (!fragment.height())
+      continue;
+
+    const uint32_t index = placements.size();
+    placements.push_back({i, uint64_t(fragment.map.offsetX(map)),
+                          uint64_t(fragment.map.offsetY(map))});
+
+    entering.emplace_back(placements.back().y, index);
+    leaving.emplace_back(placements.back().y + fragment.height(), index);
+  }
+
+  std::sort(entering.begin(), entering.end());
+  std::sort(leaving.begin(), leaving.end());
+
+  // Sweep the lines, recording the sub-canvasses crossed every time they
+  // change. The set is ordered by placement, that is, in drawing order.
+  std::set<uint32_t> current;
+  auto enter = entering.begin(), leave = leaving.begin();
+
+  while (enter != entering.end() || leave != leaving.end()) {
+    const uint64_t line =
+        std::min(enter != entering.end() ? enter->first : UINT64_MAX,
+                 leave != leaving.end() ? leave->first : UINT64_MAX);
+
+    for (; leave != leaving.end() && leave->first == line; leave++)
+      current.erase(leave->second);
+
+    for (; enter != entering.end() && enter->first == line; enter++)
+      current.insert(enter->second);
+
+    bands.push_back(line);
+    crossed.emplace_back(current.begin(), current.end());
+  }
+}
+
+size_t CompositeCanvas::getLine(uint8_t *buffer, size_t size,
+                                uint64_t y) const {
+  Statistics::Timer timer(Statistics::COMPOSE);
+
+  // The last band starting on or before the line
+  const auto band = std::upper_bound(bands.begin(), bands.end(), y);
+
+  if (band == bands.begin())
+    return 0;
+
+  size_t written = 0;
+
+  for (uint32_t index : crossed[band - bands.begin() - 1]) {
+    const Placement &placement = placements[index];
+    const Canvas &fragment = (*drawing.canvas_buffer)[placement.fragment];
+
+    written += fragment.getLine(buffer + placement.x * BYTESPERPIXEL,
+                                size - placement.x * BYTESPERPIXEL,
+                                y - placement.y);
+  }
+
+  return written;
 }
 
 bool CompositeCanvas::empty() const {
@@ -2,11 +2,14 @@
 #define CANVAS_H_
 
 #include "./helper.h"
+#include "./packed.h"
 #include "./png.h"
 #include "./section.h"
 #include "./worldloader.h"
 #include <filesystem>
+#include <functional>
 #include <map.hpp>
+#include <memory>
 #include <progress.hpp>
 
 #define CHANSPERPIXEL 4
@@ -37,10 +40,53 @@ struct Beam {
   }
 };
 
+// Sparse pixel store
+//
+// The isometric view of a map leaves large parts of its rectangle transparent:
+// the corners around the diamond of the terrain, and the sky above it. The
+// pixels are kept in square blocks, allocated the first time a pixel in them
+// is written to. Blocks never written to are read as transparent.
+struct SparseBuffer {
+  // The side of a block, in pixels
+  static constexpr size_t block = 64;
+
+  // The size of the store in pixels, and in blocks
+  size_t width = 0, height = 0;
+  size_t columns = 0, rows = 0;
+
+  std::vector<std::unique_ptr<uint8_t[]>> blocks;
+
+  // Drop all the pixels, and change the size of the store
+  void resize(size_t width, size_t height);
+
+  // The pixel at (x, y) to be written to, allocating its block if needed. The
+  // following pixels of the line are contiguous up to the end of the block.
+  inline uint8_t *write(size_t x, size_t y) {
+    std::unique_ptr<uint8_t[]> &pixels =
+        blocks[(y / block) * columns + x / block];
+
+    if (!pixels)
+      pixels = std::make_unique<uint8_t[]>(block * block * BYTESPERPIXEL);
+
+    return &pixels[((y % block) * block + x % block) * BYTESPERPIXEL];
+  }
+
+  // The pixel at (x, y), or nullptr if its block was never written to
+  const uint8_t *pixel(size_t x, size_t y) const;
+
+  // The amount of blocks allocated
+  size_t allocated() const;
+
+  // The memory used by the blocks allocated
+  size_t memory() const {
+    return allocated() * block * block * BYTESPERPIXEL;
+  }
+};
+
 // Canvas
 // Common features of all canvas types.
 struct Canvas {
-  enum BufferType { BYTES, CANVAS, IMAGE, EMPTY };
+  enum BufferType { SPARSE, PACKED, CANVAS, IMAGE, EMPTY };
 
   World::Coordinates map; // The coordinates describing the 3D map
 
@@ -59,9 +105,11 @@ struct Canvas {
 
   virtual size_t getLine(uint8_t *buffer, size_t size, uint64_t line) const {
     switch (type) {
-    case BYTES:
-      return _get_line(&drawing.bytes_buffer->operator[](0), buffer, size,
-                       line);
+    case SPARSE:
+      return _get_line(*drawing.sparse_buffer, buffer, size, line);
+
+    case PACKED:
+      return _get_line(*drawing.packed_buffer, buffer, size, line);
 
     case CANVAS:
       return _get_line(*drawing.canvas_buffer, buffer, size, line);
@@ -74,21 +122,31 @@ struct Canvas {
     }
   }
 
-  size_t _get_line(const uint8_t *, uint8_t *, size_t, uint64_t) const;
+  size_t _get_line(const SparseBuffer &, uint8_t *, size_t, uint64_t) const;
+  size_t _get_line(const PackedImage &, uint8_t *, size_t, uint64_t) const;
   size_t _get_line(PNG::PNGReader *, uint8_t *, size_t, uint64_t) const;
   size_t _get_line(const std::vector<Canvas> &, uint8_t *, size_t,
                    uint64_t) const;
 
   bool save(const std::filesystem::path, uint8_t = 0,
             Progress::Callback = Progress::Status::quiet) const;
-  bool tile(const std::filesystem::path, uint16_t tilesize,
-            Progress::Callback = Progress::Status::quiet) const;
+  // Tells if the tile of level 0 at the given position has to be written
+  using TileFilter = std::function<bool(size_t, size_t)>;
+
+  // Split the canvas in square tiles, written to `{x}/{y}.png`. With zoom
+  // levels, every level is half the size of the one before, and the tiles are
+  // written to `{z}/{x}/{y}.png`, level 0 being the full size canvas. With a
+  // filter, only the tiles covering a tile it accepts are written.
+  bool tile(const std::filesystem::path, uint16_t tilesize, uint8_t levels = 0,
+            Progress::Callback = Progress::Status::quiet,
+            const TileFilter & = nullptr) const;
 
   virtual std::string to_string() const;
 
   union DrawingBuffer {
     long null_buffer;
-    std::vector<uint8_t> *bytes_buffer;
+    SparseBuffer *sparse_buffer;
+    PackedImage *packed_buffer;
     std::vector<Canvas> *canvas_buffer;
     PNG::PNGReader *image_buffer;
 
@@ -104,8 +162,8 @@ struct Canvas {
 
     DrawingBuffer(BufferType type) {
       switch (type) {
-      case BYTES: {
-        bytes_buffer = new std::vector<uint8_t>();
+      case SPARSE: {
+        sparse_buffer = new SparseBuffer();
         break;
       }
 
@@ -114,8 +172,10 @@ struct Canvas {
         break;
       }
 
+      case PACKED:
       case IMAGE:
-        logger::error("Default constructing image canvas not supported");
+        logger::error("Default constructing packed or image canvas not "
+                      "supported");
         break;
 
       default: {
@@ -126,9 +186,15 @@ struct Canvas {
 
     void destroy(BufferType type) {
       switch (type) {
-      case BYTES: {
-        if (bytes_buffer)
-          delete bytes_buffer;
+      case SPARSE: {
+        if (sparse_buffer)
+          delete sparse_buffer;
+        break;
+      }
+
+      case PACKED: {
+        if (packed_buffer)
+          delete packed_buffer;
         break;
       }
 
@@ -182,9 +248,15 @@ struct Canvas {
 
     type = other.type;
     switch (type) {
-    case BYTES: {
-      drawing.bytes_buffer = std::move(other.drawing.bytes_buffer);
-      other.drawing.bytes_buffer = nullptr;
+    case SPARSE: {
+      drawing.sparse_buffer = std::move(other.drawing.sparse_buffer);
+      other.drawing.sparse_buffer = nullptr;
+      break;
+    }
+
+    case PACKED: {
+      drawing.packed_buffer = std::move(other.drawing.packed_buffer);
+      other.drawing.packed_buffer = nullptr;
       break;
     }
 
@@ -210,6 +282,13 @@ struct Canvas {
   ~Canvas() { drawing.destroy(type); }
 };
 
+// Blend `count` pixels of a line under the pixels in `buffer`
+void overlay(const uint8_t *line, uint8_t *buffer, size_t count);
+
+// Shrink two lines of `width` RGBA pixels into one line of half their width.
+// Every 2x2 block of pixels is averaged, the colors weighted by their opacity.
+void downsample(const uint8_t *source, size_t width, uint8_t *destination);
+
 struct ImageCanvas : Canvas {
   const std::filesystem::path file;
 
@@ -217,6 +296,60 @@ struct ImageCanvas : Canvas {
       : Canvas(map, file), file(file) {}
 };
 
+// A copy of a canvas, packed line by line
+struct PackedCanvas : Canvas {
+  explicit PackedCanvas(const Canvas &);
+
+  // A canvas packed in `file`, empty if the file does not match the map
+  PackedCanvas(const World::Coordinates &map, const fs::path &file);
+
+  PackedImage &image() { return *drawing.packed_buffer; }
+};
+
+// Shaded and lit colors of the blocks of an index
+//
+// Shading and lighting modify the colors of every block drawn, depending on its
+// height or the light around it. The results only depend on the block and a
+// handful of levels, so they are computed once before rendering and shared by
+// all the canvasses drawing with the index.
+struct ColorTables {
+  using id_t = Colors::Index::id_t;
+
+  // The colors of a block lit from all sides by the same light level
+  struct Faces {
+    Colors::Color primary, secondary, light, dark;
+  };
+
+  ColorTables() : blocks(0){};
+  ColorTables(const Colors::Index &, bool shading, bool lighting);
+
+  // Whether the block `id` has its colors in the tables
+  bool shades(id_t id) const { return id < blocks && !shaded.empty(); }
+  bool lights(id_t id) const { return id < blocks && !faces.empty(); }
+
+  // The block `id` shaded for a height `y`
+  const Colors::Block &shade(id_t id, int32_t y) const {
+    return shaded[id * mcmap::constants::terrain_height + y -
+                  mcmap::constants::min_y];
+  }
+
+  // The block `id` emitting `light`
+  const Colors::Block &emit(id_t id, uint8_t light) const {
+    return emitting[id * 16 + light];
+  }
+
+  // The colors of the block `id` lit by `light`
+  const Faces &lit(id_t id, uint8_t light) const {
+    return faces[id * 16 + light];
+  }
+
+private:
+  size_t blocks;
+
+  std::vector<Colors::Block> shaded, emitting;
+  std::vector<Faces> faces;
+};
+
 // Isometric canvas
 // This structure holds the final bitmap data, a 2D array of pixels. It is
 // created with a set of 3D coordinates, and translate every block drawn
@@ -244,6 +377,9 @@ struct IsometricCanvas : Canvas {
 
   std::array<float, mcmap::constants::terrain_height> brightnessLookup;
 
+  // Precomputed shading and lighting, if available
+  const ColorTables *tables = nullptr;
+
   Chunk::section_array_t::const_iterator current_section, last_section,
       left_section, right_section;
 
@@ -261,11 +397,22 @@ struct IsometricCanvas : Canvas {
   // available
   Chunk::section_array_t empty_section;
 
-  IsometricCanvas() : Canvas(BYTES), rendered(0) { empty_section.resize(1); }
+  // A block sprite covering two blocks of the sparse buffer is not contiguous
+  // in it: it is drawn here, then copied back
+  static constexpr uint8_t spriteWidth = 4, spriteHeight = 5;
+  bool straddling = false;
+  uint32_t spriteX, spriteY;
+  std::array<uint8_t, spriteWidth * spriteHeight * BYTESPERPIXEL> sprite;
+
+  IsometricCanvas() : Canvas(SPARSE), rendered(0) { empty_section.resize(1); }
+
+  // The memory needed to draw the map, counting only the blocks of the sparse
+  // buffer the isometric view of the map can cover
+  static size_t footprint(const World::Coordinates &);
 
   inline bool empty() const { return !rendered; }
 
-  void setColors(const Colors::Palette &);
+  void setColors(const Colors::Palette &, const ColorTables * = nullptr);
   void setMap(const World::Coordinates &);
   void setMarkers(uint8_t n, const marker_array_t array) {
     totalMarkers = n;
@@ -276,8 +423,14 @@ struct IsometricCanvas : Canvas {
   // Helpers for position lookup
   void orientChunk(int32_t &x, int32_t &z);
   void orientSection(uint8_t &x, uint8_t &z);
+  // The pixel at (x, y) to be drawn to, allocating its block if needed: only
+  // ask for the pixels actually drawn
   inline uint8_t *pixel(uint32_t x, uint32_t y) {
-    return &(*drawing.bytes_buffer)[(x + y * width) * BYTESPERPIXEL];
+    if (straddling)
+      return &sprite[((y - spriteY) * spriteWidth + x - spriteX) *
+                     BYTESPERPIXEL];
+
+    return drawing.sparse_buffer->write(x, y);
   }
 
   // Drawing entrypoints
@@ -286,7 +439,8 @@ struct IsometricCanvas : Canvas {
   void renderSection(const Section &);
   // Draw a block from virtual coords in the canvas
   void renderBlock(const Colors::Block *, const uint32_t, const uint32_t,
-                   const int32_t, const nbt::NBT &);
+                   const int32_t, const BlockState &,
+                   const Colors::Index::id_t = Colors::Index::unknown);
 
   // Empty section with only beams
   void renderBeamSection(const int64_t, const int64_t, const uint8_t);
@@ -323,9 +477,30 @@ struct CompositeCanvas : public Canvas {
   // |     +------------+|
   // +-------------------+
 
+  //
+  // The offsets of the sub-canvasses are computed once, and the lines where
+  // sub-canvasses start or end are indexed: reading a line only goes through
+  // the sub-canvasses it crosses.
+
   CompositeCanvas(std::vector<Canvas> &&);
 
   bool empty() const;
+
+  size_t getLine(uint8_t *buffer, size_t size, uint64_t line) const override;
+
+private:
+  // The position of a sub-canvas in the composite image
+  struct Placement {
+    size_t fragment; // Index of the sub-canvas
+    uint64_t x, y;   // Offset of its top left corner
+  };
+
+  std::vector<Placement> placements;
+
+  // The lines where the set of sub-canvasses crossed changes, and the
+  // placements crossed from each of those lines, in drawing order
+  std::vector<uint64_t> bands;
+  std::vector<std::vector<uint32_t>> crossed;
 };
 
 #endif
@@ -1,13 +1,14 @@
 #include "./chunk.h"
 #include "./chunk_format_versions/assert.hpp"
 #include "./chunk_format_versions/get_section.hpp"
+#include "./statistics.h"
 #include <compat.hpp>
 #include <functional>
 
 namespace mcmap {
 
 namespace versions {
-std::map<int, std::function<bool(const nbt::NBT &)>> assert = {
+std::map<int, std::function<bool(const nbt::View &)>> assert = {
     {2844, assert_versions::v2844},
 #ifdef SNAPSHOT_SUPPORT
     {2840, assert_versions::v2840},
@@ -16,17 +17,32 @@ std::map<int, std::function<bool(const nbt::NBT &)>> assert = {
     {0, assert_versions::catchall},
 };
 
-std::map<int, std::function<nbt::NBT(const nbt::NBT &)>> sections = {
-    {2844, sections_versions::v2844},
-    {1628, sections_versions::v1628},
-    {0, sections_versions::catchall},
+std::map<int, std::function<const nbt::View &(const nbt::View &)>>
+    sections = {
+        {2844, sections_versions::v2844},
+        {1628, sections_versions::v1628},
+        {0, sections_versions::catchall},
 };
 
 } // namespace versions
 
+// Only those tags are read from the chunk data, in any supported version. The
+// rest (entities, heightmaps, biomes, structures ...) is skipped when parsing.
+const nbt::Filter section_fields = {
+    {"Y", {}},           {"BlockLight", {}},   {"Palette", {}},
+    {"BlockStates", {}}, {"block_states", {}},
+};
+
+const nbt::Filter Chunk::fields = {
+    {"DataVersion", {}},
+    {"Status", {}},
+    {"sections", section_fields},
+    {"Level", {{"Status", {}}, {"Sections", section_fields}}},
+};
+
 Chunk::Chunk() : data_version(-1) {}
 
-Chunk::Chunk(const nbt::NBT &data, const Colors::Palette &palette,
+Chunk::Chunk(const nbt::View &data, const Colors::Index &palette,
              const coordinates pos)
     : Chunk() {
   position = pos;
@@ -40,16 +56,18 @@ Chunk::Chunk(const nbt::NBT &data, const Colors::Palette &palette,
   // in the sections
   data_version = data["DataVersion"].get<int>();
 
-  nbt::NBT sections_list;
-
   auto sections_it = compatible(versions::sections, data_version);
 
   if (sections_it != versions::sections.end()) {
-    sections_list = sections_it->second(data);
+    Statistics::Timer timer(Statistics::SECTIONS);
+    const nbt::View &sections_list = sections_it->second(data);
+
+    sections.reserve(sections_list.size());
 
     for (const auto &raw_section : sections_list) {
-      Section section(raw_section, data_version, this->position);
-      section.loadPalette(palette);
+      Section section(raw_section, data_version, palette, this->position);
+      Statistics::count(section.empty() ? Statistics::SECTIONS_SKIPPED
+                                        : Statistics::SECTIONS_DECODED);
       sections.push_back(std::move(section));
     }
   }
@@ -65,7 +83,7 @@ Chunk &Chunk::operator=(Chunk &&other) {
   return *this;
 }
 
-bool Chunk::assert_chunk(const nbt::NBT &chunk) {
+bool Chunk::assert_chunk(const nbt::View &chunk) {
   if (chunk.is_end()                     // Catch uninitialized chunks
       || !chunk.contains("DataVersion")) // Dataversion is required
     return false;
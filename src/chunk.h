@@ -3,12 +3,13 @@
 #include "./section.h"
 #include <2DCoordinates.hpp>
 #include <map.hpp>
-#include <nbt/nbt.hpp>
+#include <nbt/filter.hpp>
+#include <nbt/view.hpp>
 
 namespace mcmap {
 
 struct Chunk {
-  using nbt_t = nbt::NBT;
+  using nbt_t = nbt::View;
   using version_t = int32_t;
   using section_t = Section;
   using section_array_t = std::vector<section_t>;
@@ -19,14 +20,34 @@ struct Chunk {
   section_array_t sections;
 
   Chunk();
-  Chunk(const nbt_t &, const Colors::Palette &, const coordinates);
+  Chunk(const nbt_t &, const Colors::Index &, const coordinates);
   Chunk(Chunk &&);
 
   Chunk &operator=(Chunk &&);
 
   bool valid() const { return data_version != -1; }
 
+  // Get the section at height `y`, or the end of the sections if there is none
+  section_array_t::const_iterator section(int8_t y) const {
+    // The sections are stored from the bottom up, usually without gaps
+    if (!sections.empty()) {
+      const size_t index = size_t(y - sections.front().Y);
+
+      if (index < sections.size() && sections[index].Y == y)
+        return sections.begin() + index;
+    }
+
+    for (auto it = sections.begin(); it != sections.end(); it++)
+      if (it->Y == y)
+        return it;
+
+    return sections.end();
+  }
+
   static bool assert_chunk(const nbt_t &);
+
+  // The tags of the chunk data used to create a chunk
+  static const nbt::Filter fields;
 };
 
 } // namespace mcmap
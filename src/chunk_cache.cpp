@@ -0,0 +1,248 @@
+#include "./chunk_cache.h"
+#include "./statistics.h"
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <zlib.h>
+
+namespace Terrain {
+
+namespace {
+
+// The magic number changes with the format of the files. It is written in the
+// byte order of the machine, files from another platform are ignored.
+const uint32_t magic = 0x3143434d; // MCC1
+
+struct Writer {
+  std::vector<uint8_t> data;
+
+  template <typename T> void put(T value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+  }
+
+  void put(const uint8_t *bytes, size_t size) {
+    data.insert(data.end(), bytes, bytes + size);
+  }
+};
+
+struct Reader {
+  const uint8_t *position, *end;
+
+  // Consume `size` bytes, returning their address or nullptr if the file is
+  // too short
+  const uint8_t *take(size_t size) {
+    if (size_t(end - position) < size)
+      return nullptr;
+
+    const uint8_t *taken = position;
+    position += size;
+    return taken;
+  }
+
+  template <typename T> bool get(T *value) {
+    const uint8_t *bytes = take(sizeof(T));
+
+    if (bytes)
+      memcpy(value, bytes, sizeof(T));
+
+    return bytes;
+  }
+};
+
+} // namespace
+
+ChunkCache::ChunkCache(const fs::path &root, const fs::path &regions) {
+  std::error_code error;
+  const fs::path absolute = fs::absolute(regions, error).lexically_normal();
+
+  // The cache of every world is kept apart
+  directory = root / fmt::format("{:016x}", std::hash<std::string>{}(
+                                                absolute.string()));
+}
+
+ChunkCache::Key ChunkCache::key(const Region &region, uint16_t index) {
+  const ChunkData compressed = region.chunk(index);
+
+  return {region.locations[index].raw_data, region.timestamps[index],
+          uint32_t(crc32(crc32(0, Z_NULL, 0), compressed.data,
+                         compressed.size))};
+}
+
+fs::path ChunkCache::file(const ChunkCoordinates coords) const {
+  const std::string region =
+      fmt::format("r.{}.{}", REGION(coords.x), REGION(coords.z));
+
+  return directory / region / fmt::format("{}.{}.chunk", coords.x, coords.z);
+}
+
+ChunkCache::Chunk ChunkCache::load(const ChunkCoordinates coords,
+                                   const Key &key,
+                                   const Colors::Index &index) const {
+  std::ifstream input(file(coords), std::ifstream::binary | std::ifstream::ate);
+
+  if (!input)
+    return Chunk();
+
+  std::vector<uint8_t> contents(input.tellg());
+  input.seekg(0);
+
+  if (!input.read(reinterpret_cast<char *>(contents.data()), contents.size()))
+    return Chunk();
+
+  Statistics::count(Statistics::BYTES_READ, contents.size());
+
+  Reader reader = {contents.data(), contents.data() + contents.size()};
+  uint32_t format;
+  Key stored;
+  Chunk::version_t version;
+  uint16_t count;
+
+  if (!reader.get(&format) || format != magic || !reader.get(&stored) ||
+      !(stored == key) || !reader.get(&version) || !reader.get(&count))
+    return Chunk();
+
+  Chunk chunk;
+  chunk.position = coords;
+  chunk.sections.reserve(count);
+
+  for (uint16_t i = 0; i < count; i++) {
+    Section section;
+    uint8_t lit;
+    uint16_t entries;
+
+    section.parent_chunk_coordinates = coords;
+
+    if (!reader.get(&section.Y) || !reader.get(&lit) || !reader.get(&entries))
+      return Chunk();
+
+    if (entries)
+      section.colors.clear();
+
+    for (uint16_t j = 0; j < entries; j++) {
+      uint16_t state, length;
+      const uint8_t *name;
+
+      if (!reader.get(&state) || !reader.get(&length) ||
+          !(name = reader.take(length)))
+        return Chunk();
+
+      section.addEntry(
+          std::string_view(reinterpret_cast<const char *>(name), length),
+          BlockState::unpack(state), index);
+    }
+
+    // Sections with a single block in their palette have all their blocks set
+    // to it already; the indexes are stored on a byte when they fit
+    if (entries > 256) {
+      const uint8_t *blocks = reader.take(section.blocks.size() * 2);
+
+      if (!blocks)
+        return Chunk();
+
+      memcpy(section.blocks.data(), blocks, section.blocks.size() * 2);
+    } else if (entries > 1) {
+      const uint8_t *blocks = reader.take(section.blocks.size());
+
+      if (!blocks)
+        return Chunk();
+
+      for (size_t k = 0; k < section.blocks.size(); k++)
+        section.blocks[k] = blocks[k];
+    }
+
+    for (auto &block : section.blocks)
+      if (entries && block >= entries)
+        return Chunk();
+
+    if (lit) {
+      const uint8_t *lights = reader.take(section.lights.size());
+
+      if (!lights)
+        return Chunk();
+
+      memcpy(section.lights.data(), lights, section.lights.size());
+    }
+
+    section.markOccluders();
+    chunk.sections.push_back(std::move(section));
+  }
+
+  chunk.data_version = version;
+  return chunk;
+}
+
+bool ChunkCache::store(const Chunk &chunk, const Key &key,
+                       const Colors::Index &index) const {
+  Writer writer;
+
+  writer.put(magic);
+  writer.put(key);
+  writer.put(chunk.data_version);
+  writer.put(uint16_t(chunk.sections.size()));
+
+  for (const auto &section : chunk.sections) {
+    const uint16_t entries = section.ids.size();
+    bool lit = false;
+
+    for (auto light : section.lights)
+      lit = lit || light;
+
+    writer.put(section.Y);
+    writer.put(uint8_t(lit));
+    writer.put(entries);
+
+    for (uint16_t j = 0; j < entries; j++) {
+      if (section.ids[j] == Colors::Index::unknown)
+        return false;
+
+      const std::string &name = index.name(section.ids[j]);
+
+      writer.put(section.states[j].pack());
+      writer.put(uint16_t(name.size()));
+      writer.put(reinterpret_cast<const uint8_t *>(name.data()), name.size());
+    }
+
+    if (entries > 256)
+      writer.put(reinterpret_cast<const uint8_t *>(section.blocks.data()),
+                 section.blocks.size() * 2);
+    else if (entries > 1)
+      for (auto block : section.blocks)
+        writer.put(uint8_t(block));
+
+    if (lit)
+      writer.put(section.lights.data(), section.lights.size());
+  }
+
+  const fs::path destination = file(chunk.position);
+  std::error_code error;
+
+  fs::create_directories(destination.parent_path(), error);
+
+  // The file is written aside and moved in place, for the other threads and
+  // processes to never read a partial file
+  const fs::path temporary = fmt::format(
+      "{}.{:x}", destination.string(),
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+  std::ofstream output(temporary, std::ofstream::binary);
+  output.write(reinterpret_cast<const char *>(writer.data.data()),
+               writer.data.size());
+  output.close();
+
+  if (!output) {
+    logger::debug("Failed to cache chunk {} {}", chunk.position.x,
+                  chunk.position.z);
+    fs::remove(temporary, error);
+    return false;
+  }
+
+  fs::rename(temporary, destination, error);
+
+  if (!error)
+    Statistics::count(Statistics::BYTES_WRITTEN, writer.data.size());
+
+  return !error;
+}
+
+} // namespace Terrain
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "./chunk.h"
+#include "./region.h"
+#include <filesystem>
+
+namespace Terrain {
+
+// On-disk cache of decoded chunks
+//
+// Decoding a chunk means inflating its data, parsing the NBT, unpacking the
+// block states and decoding the properties of the palette entries. The result
+// is saved in a compact binary file per chunk, holding for every section the
+// names and properties of its palette, its blocks and its light. The names are
+// resolved through the color index when a chunk is read back, so the cache is
+// shared by renders with other colors, orientations or boundaries.
+//
+// A cached chunk is identified by its location, modification time and
+// checksum in the region file, and is decoded again when any of them changes.
+struct ChunkCache {
+  using Chunk = mcmap::Chunk;
+  using ChunkCoordinates = mcmap::Chunk::coordinates;
+
+  struct Key {
+    uint32_t location, timestamp, checksum;
+
+    bool operator==(const Key &other) const {
+      return location == other.location && timestamp == other.timestamp &&
+             checksum == other.checksum;
+    }
+  };
+
+  // Cache for the region files of `regions`, stored in `root`
+  ChunkCache(const fs::path &root, const fs::path &regions);
+
+  // The identity of the chunk of index `index` (x + 32 * z) in its region
+  static Key key(const Region &, uint16_t index);
+
+  // Read a chunk back, or return an invalid chunk if it is not cached under
+  // this key
+  Chunk load(const ChunkCoordinates, const Key &, const Colors::Index &) const;
+
+  // Save a decoded chunk. Chunks with blocks missing from the index are not
+  // saved, as they could not be resolved with another color file.
+  bool store(const Chunk &, const Key &, const Colors::Index &) const;
+
+private:
+  fs::path directory;
+
+  fs::path file(const ChunkCoordinates) const;
+};
+
+} // namespace Terrain
@@ -1,19 +1,19 @@
-#include <nbt/nbt.hpp>
+#include <nbt/view.hpp>
 
 namespace mcmap {
 namespace versions {
 namespace assert_versions {
-bool v2844(const nbt::NBT &chunk);
+bool v2844(const nbt::View &chunk);
 
 #ifdef SNAPSHOT_SUPPORT
-bool v2840(const nbt::NBT &chunk);
+bool v2840(const nbt::View &chunk);
 #endif
 
-bool v1976(const nbt::NBT &chunk);
+bool v1976(const nbt::View &chunk);
 
-bool v1628(const nbt::NBT &chunk);
+bool v1628(const nbt::View &chunk);
 
-bool catchall(const nbt::NBT &chunk);
+bool catchall(const nbt::View &chunk);
 } // namespace assert_versions
 } // namespace versions
 } // namespace mcmap
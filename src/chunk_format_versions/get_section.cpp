@@ -3,11 +3,15 @@
 namespace mcmap {
 namespace versions {
 namespace sections_versions {
-nbt::NBT v2844(const nbt::NBT &chunk) { return chunk["sections"]; }
-nbt::NBT v1628(const nbt::NBT &chunk) { return chunk["Level"]["Sections"]; }
-nbt::NBT catchall(const nbt::NBT &chunk) {
+const nbt::View &v2844(const nbt::View &chunk) { return chunk["sections"]; }
+const nbt::View &v1628(const nbt::View &chunk) {
+  return chunk["Level"]["Sections"];
+}
+const nbt::View &catchall(const nbt::View &chunk) {
+  static const nbt::View no_sections;
+
   logger::trace("Unsupported DataVersion: {}", chunk["DataVersion"].get<int>());
-  return nbt::NBT(std::vector<nbt::NBT>());
+  return no_sections;
 }
 } // namespace sections_versions
 } // namespace versions
@@ -1,11 +1,11 @@
-#include <nbt/nbt.hpp>
+#include <nbt/view.hpp>
 
 namespace mcmap {
 namespace versions {
 namespace sections_versions {
-nbt::NBT v2844(const nbt::NBT &);
-nbt::NBT v1628(const nbt::NBT &);
-nbt::NBT catchall(const nbt::NBT &);
+const nbt::View &v2844(const nbt::View &);
+const nbt::View &v1628(const nbt::View &);
+const nbt::View &catchall(const nbt::View &);
 } // namespace sections_versions
 } // namespace versions
 } // namespace mcmap
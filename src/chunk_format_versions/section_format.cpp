@@ -1,11 +1,215 @@
 #include "section_format.hpp"
+#include <array>
+#include <translator.hpp>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 namespace mcmap {
 namespace versions {
 namespace block_states_versions {
-void post116(const uint8_t index_length,
-             const std::vector<int64_t> *blockStates,
-             Section::block_array &buffer) {
+namespace {
+// Unpackers specialized for every index length between 4 and 12. They read
+// the big-endian long array straight from the chunk data; as the length is
+// known at compile time every shift and mask below is a constant, and the
+// per-index loops are unrolled.
+
+using unpacker = void (*)(const uint8_t *, uint16_t *);
+
+template <uint8_t length>
+constexpr uint64_t index_mask = (uint64_t(1) << length) - 1;
+
+inline uint64_t long_at(const uint8_t *data, size_t index) {
+  return translate<uint64_t>(data + 8 * index);
+}
+
+// Post 1.16: every long holds 64 / length indexes, the leftover bits being
+// padding
+template <uint8_t length, size_t... slot>
+inline void unpack_long(uint64_t data, uint16_t *out,
+                        std::index_sequence<slot...>) {
+  ((out[slot] = (data >> (slot * length)) & index_mask<length>), ...);
+}
+
+template <uint8_t length>
+void unpack_post116(const uint8_t *data, uint16_t *buffer) {
+  constexpr uint16_t per_long = 64 / length;
+  constexpr uint16_t full_longs = 4096 / per_long;
+
+  for (uint16_t i = 0; i < full_longs; i++)
+    unpack_long<length>(long_at(data, i), buffer + i * per_long,
+                        std::make_index_sequence<per_long>());
+
+  // The last long is not always full
+  if constexpr (4096 % per_long != 0) {
+    const uint64_t last = long_at(data, full_longs);
+
+    for (uint16_t slot = 0; slot < 4096 % per_long; slot++)
+      buffer[full_longs * per_long + slot] =
+          (last >> (slot * length)) & index_mask<length>;
+  }
+}
+
+// Pre 1.16: indexes overflow from one long to the next, and every group of
+// `length` longs holds exactly 64 indexes
+template <uint8_t length, size_t index>
+inline uint16_t extract(const uint64_t *longs) {
+  constexpr size_t word = (index * length) / 64;
+  constexpr size_t offset = (index * length) % 64;
+
+  if constexpr (offset + length > 64)
+    return ((longs[word] >> offset) | (longs[word + 1] << (64 - offset))) &
+           index_mask<length>;
+  else
+    return (longs[word] >> offset) & index_mask<length>;
+}
+
+template <uint8_t length, size_t... index>
+inline void unpack_group(const uint64_t *longs, uint16_t *out,
+                         std::index_sequence<index...>) {
+  ((out[index] = extract<length, index>(longs)), ...);
+}
+
+template <uint8_t length>
+void unpack_pre116(const uint8_t *data, uint16_t *buffer) {
+  uint64_t longs[length];
+
+  for (uint16_t group = 0; group < 64; group++) {
+    for (uint8_t i = 0; i < length; i++)
+      longs[i] = long_at(data, group * length + i);
+
+    unpack_group<length>(longs, buffer + group * 64,
+                         std::make_index_sequence<64>());
+  }
+}
+
+// When the length divides 64, both formats are the same and indexes are
+// aligned on nibbles or bytes; those are expanded with vector instructions
+#if defined(__AVX2__)
+template <> void unpack_post116<4>(const uint8_t *data, uint16_t *buffer) {
+  // Reverse the bytes of every long to get them in little-endian order
+  const __m256i reverse =
+      _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7,
+                       6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+  // 4 longs, 64 indexes per iteration
+  for (uint16_t i = 0; i < 64; i++) {
+    const __m256i bytes = _mm256_shuffle_epi8(
+        _mm256_loadu_si256((const __m256i *)(data + 32 * i)), reverse);
+    const __m256i low = _mm256_and_si256(bytes, nibble);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble);
+
+    // Interleaving the nibbles gives longs 0 and 2, then 1 and 3
+    const __m256i even = _mm256_unpacklo_epi8(low, high);
+    const __m256i odd = _mm256_unpackhi_epi8(low, high);
+
+    __m256i *out = (__m256i *)(buffer + 64 * i);
+    _mm256_storeu_si256(out,
+                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(even)));
+    _mm256_storeu_si256(out + 1,
+                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(odd)));
+    _mm256_storeu_si256(
+        out + 2, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(even, 1)));
+    _mm256_storeu_si256(
+        out + 3, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(odd, 1)));
+  }
+}
+
+template <> void unpack_post116<8>(const uint8_t *data, uint16_t *buffer) {
+  const __m256i reverse =
+      _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7,
+                       6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+  // 4 longs, 32 indexes per iteration
+  for (uint16_t i = 0; i < 128; i++) {
+    const __m256i bytes = _mm256_shuffle_epi8(
+        _mm256_loadu_si256((const __m256i *)(data + 32 * i)), reverse);
+
+    __m256i *out = (__m256i *)(buffer + 32 * i);
+    _mm256_storeu_si256(out,
+                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+    _mm256_storeu_si256(
+        out + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+  }
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+inline __m128i reverse_longs(__m128i bytes) {
+  // Swap the bytes of every word, then reverse the words of every long
+  bytes = _mm_or_si128(_mm_slli_epi16(bytes, 8), _mm_srli_epi16(bytes, 8));
+  bytes = _mm_shufflelo_epi16(bytes, _MM_SHUFFLE(0, 1, 2, 3));
+  return _mm_shufflehi_epi16(bytes, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+template <> void unpack_post116<4>(const uint8_t *data, uint16_t *buffer) {
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+
+  // 2 longs, 32 indexes per iteration
+  for (uint16_t i = 0; i < 128; i++) {
+    const __m128i bytes =
+        reverse_longs(_mm_loadu_si128((const __m128i *)(data + 16 * i)));
+    const __m128i low = _mm_and_si128(bytes, nibble);
+    const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble);
+
+    const __m128i first = _mm_unpacklo_epi8(low, high);
+    const __m128i second = _mm_unpackhi_epi8(low, high);
+
+    __m128i *out = (__m128i *)(buffer + 32 * i);
+    _mm_storeu_si128(out, _mm_unpacklo_epi8(first, zero));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(first, zero));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi8(second, zero));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi8(second, zero));
+  }
+}
+
+template <> void unpack_post116<8>(const uint8_t *data, uint16_t *buffer) {
+  const __m128i zero = _mm_setzero_si128();
+
+  // 2 longs, 16 indexes per iteration
+  for (uint16_t i = 0; i < 256; i++) {
+    const __m128i bytes =
+        reverse_longs(_mm_loadu_si128((const __m128i *)(data + 16 * i)));
+
+    __m128i *out = (__m128i *)(buffer + 16 * i);
+    _mm_storeu_si128(out, _mm_unpacklo_epi8(bytes, zero));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(bytes, zero));
+  }
+}
+#endif
+
+template <> void unpack_pre116<4>(const uint8_t *data, uint16_t *buffer) {
+  unpack_post116<4>(data, buffer);
+}
+
+template <> void unpack_pre116<8>(const uint8_t *data, uint16_t *buffer) {
+  unpack_post116<8>(data, buffer);
+}
+
+template <size_t... length>
+constexpr std::array<unpacker, sizeof...(length)>
+    post116_unpackers(std::index_sequence<length...>) {
+  return {unpack_post116<length + 4>...};
+}
+
+template <size_t... length>
+constexpr std::array<unpacker, sizeof...(length)>
+    pre116_unpackers(std::index_sequence<length...>) {
+  return {unpack_pre116<length + 4>...};
+}
+
+// Unpackers for lengths 4 to 12, indexed by length - 4
+const auto post116_specialized =
+    post116_unpackers(std::make_index_sequence<9>());
+const auto pre116_specialized = pre116_unpackers(std::make_index_sequence<9>());
+
+// Reference implementations, for any index length
+void post116_any(const uint8_t index_length, const block_states_t &blockStates,
+                 Section::block_array &buffer) {
   // NEW in 1.16, longs are padded by 0s when a block cannot fit, so no more
   // overflow to deal with !
 
@@ -22,15 +226,15 @@ void post116(const uint8_t index_length,
 
     // Bring the data to the first bits of the long, then extract it by bitwise
     // comparison
-    const uint16_t blockIndex = ((*blockStates)[longIndex] >> padding) &
+    const uint16_t blockIndex = (blockStates[longIndex] >> padding) &
                                 ((uint64_t(1) << index_length) - 1);
 
     buffer[index] = blockIndex;
   }
 }
 
-void pre116(const uint8_t index_length, const std::vector<int64_t> *blockStates,
-            Section::block_array &buffer) {
+void pre116_any(const uint8_t index_length, const block_states_t &blockStates,
+                Section::block_array &buffer) {
   // The `BlockStates` array contains data on the section's blocks. You have to
   // extract it by understanfing its structure.
   //
@@ -79,13 +283,13 @@ void pre116(const uint8_t index_length, const std::vector<int64_t> *blockStates,
     // If there is an overflow, the mask size is reduced, as not to catch noise
     // from the padding (ie the interrogation points earlier) that appear on
     // ARM32.
-    uint16_t lower_data = ((*blockStates)[skip_longs] >> padding) &
+    uint16_t lower_data = (blockStates[skip_longs] >> padding) &
                           ((uint64_t(1) << (index_length - overflow)) - 1);
 
     if (overflow > 0) {
       // The exact same process is used to catch the overflow from the next long
       const uint16_t upper_data =
-          ((*blockStates)[skip_longs + 1]) & ((uint64_t(1) << overflow) - 1);
+          (blockStates[skip_longs + 1]) & ((uint64_t(1) << overflow) - 1);
       // We then associate both values to create the final value
       lower_data = lower_data | (upper_data << (index_length - overflow));
     }
@@ -94,25 +298,49 @@ void pre116(const uint8_t index_length, const std::vector<int64_t> *blockStates,
     buffer[index] = lower_data;
   }
 }
+} // namespace
+
+void post116(const uint8_t index_length, const block_states_t &blockStates,
+             Section::block_array &buffer) {
+  const uint16_t blocksPerLong = 64 / index_length;
+
+  if (blockStates.size() < size_t(4095 / blocksPerLong + 1)) {
+    logger::trace("Malformed section: not enough block states");
+    return;
+  }
+
+  if (index_length < 4 || index_length > 12)
+    return post116_any(index_length, blockStates, buffer);
+
+  post116_specialized[index_length - 4](blockStates.data, buffer.data());
+}
+
+void pre116(const uint8_t index_length, const block_states_t &blockStates,
+            Section::block_array &buffer) {
+  if (blockStates.size() < size_t(64 * index_length)) {
+    logger::trace("Malformed section: not enough block states");
+    return;
+  }
+
+  if (index_length < 4 || index_length > 12)
+    return pre116_any(index_length, blockStates, buffer);
+
+  pre116_specialized[index_length - 4](blockStates.data, buffer.data());
+}
 } // namespace block_states_versions
 
 namespace init_versions {
-void v1628(Section *target, const nbt::NBT &raw_section) {
+void v1628(Section *target, const nbt::View &raw_section,
+           const Colors::Index &index) {
   if (raw_section.contains("BlockStates") && raw_section.contains("Palette")) {
-    target->palette =
-        *raw_section["Palette"].get<const std::vector<nbt::NBT> *>();
-    const nbt::NBT::tag_long_array_t *blockStates =
-        raw_section["BlockStates"].get<const nbt::NBT::tag_long_array_t *>();
-
-    // Remove the air that is default-constructed
-    target->colors.clear();
-    // Anticipate the color input from the palette's size
-    target->colors.reserve(target->palette.size());
+    target->loadPalette(raw_section["Palette"], index);
+    const block_states_versions::block_states_t blockStates =
+        raw_section["BlockStates"].array<int64_t>();
 
     // The length in bits of a block is the log2 of the palette's size or 4,
     // whichever is greatest. Ranges from 4 to 12.
     const uint8_t blockBitLength =
-        std::max(uint8_t(ceil(log2(target->palette.size()))), uint8_t(4));
+        std::max(uint8_t(ceil(log2(target->ids.size()))), uint8_t(4));
 
     // Parse the blockstates for block info
     block_states_versions::pre116(blockBitLength, blockStates, target->blocks);
@@ -121,22 +349,17 @@ void v1628(Section *target, const nbt::NBT &raw_section) {
                   target->Y);
 }
 
-void v2534(Section *target, const nbt::NBT &raw_section) {
+void v2534(Section *target, const nbt::View &raw_section,
+           const Colors::Index &index) {
   if (raw_section.contains("BlockStates") && raw_section.contains("Palette")) {
-    target->palette =
-        *raw_section["Palette"].get<const std::vector<nbt::NBT> *>();
-    const nbt::NBT::tag_long_array_t *blockStates =
-        raw_section["BlockStates"].get<const nbt::NBT::tag_long_array_t *>();
-
-    // Remove the air that is default-constructed
-    target->colors.clear();
-    // Anticipate the color input from the palette's size
-    target->colors.reserve(target->palette.size());
+    target->loadPalette(raw_section["Palette"], index);
+    const block_states_versions::block_states_t blockStates =
+        raw_section["BlockStates"].array<int64_t>();
 
     // The length in bits of a block is the log2 of the palette's size or 4,
     // whichever is greatest. Ranges from 4 to 12.
     const uint8_t blockBitLength =
-        std::max(uint8_t(ceil(log2(target->palette.size()))), uint8_t(4));
+        std::max(uint8_t(ceil(log2(target->ids.size()))), uint8_t(4));
 
     // Parse the blockstates for block info
     block_states_versions::post116(blockBitLength, blockStates, target->blocks);
@@ -145,25 +368,19 @@ void v2534(Section *target, const nbt::NBT &raw_section) {
                   target->Y);
 }
 
-void v2840(Section *target, const nbt::NBT &raw_section) {
+void v2840(Section *target, const nbt::View &raw_section,
+           const Colors::Index &index) {
   if (raw_section.contains("block_states") &&
       raw_section["block_states"].contains("data") &&
       raw_section["block_states"].contains("palette")) {
-    target->palette = *raw_section["block_states"]["palette"]
-                           .get<const std::vector<nbt::NBT> *>();
-    const nbt::NBT::tag_long_array_t *blockStates =
-        raw_section["block_states"]["data"]
-            .get<const nbt::NBT::tag_long_array_t *>();
-
-    // Remove the air that is default-constructed
-    target->colors.clear();
-    // Anticipate the color input from the palette's size
-    target->colors.reserve(target->palette.size());
+    target->loadPalette(raw_section["block_states"]["palette"], index);
+    const block_states_versions::block_states_t blockStates =
+        raw_section["block_states"]["data"].array<int64_t>();
 
     // The length in bits of a block is the log2 of the palette's size or 4,
     // whichever is greatest. Ranges from 4 to 12.
     const uint8_t blockBitLength =
-        std::max(uint8_t(ceil(log2(target->palette.size()))), uint8_t(4));
+        std::max(uint8_t(ceil(log2(target->ids.size()))), uint8_t(4));
 
     // Parse the blockstates for block info
     block_states_versions::post116(blockBitLength, blockStates, target->blocks);
@@ -172,29 +389,24 @@ void v2840(Section *target, const nbt::NBT &raw_section) {
                   target->Y);
 }
 
-void v3100(Section *target, const nbt::NBT &raw_section) {
+void v3100(Section *target, const nbt::View &raw_section,
+           const Colors::Index &index) {
   // NEW in 1.19, some sections can omit the block_states array when only one
   // block is present in the palette to signify that the whole section is
   // filled with one block, so this checks for that special case
 
   if (raw_section.contains("block_states") &&
       raw_section["block_states"].contains("palette")) {
-    target->palette = *raw_section["block_states"]["palette"]
-                           .get<const std::vector<nbt::NBT> *>();
-    // Remove the air that is default-constructed
-    target->colors.clear();
-    // Anticipate the color input from the palette's size
-    target->colors.reserve(target->palette.size());
+    target->loadPalette(raw_section["block_states"]["palette"], index);
 
     if (raw_section["block_states"].contains("data")) {
-      const nbt::NBT::tag_long_array_t *blockStates =
-          raw_section["block_states"]["data"]
-              .get<const nbt::NBT::tag_long_array_t *>();
+      const block_states_versions::block_states_t blockStates =
+          raw_section["block_states"]["data"].array<int64_t>();
 
       // The length in bits of a block is the log2 of the palette's size or 4,
       // whichever is greatest. Ranges from 4 to 12.
       const uint8_t blockBitLength =
-          std::max(uint8_t(ceil(log2(target->palette.size()))), uint8_t(4));
+          std::max(uint8_t(ceil(log2(target->ids.size()))), uint8_t(4));
 
       // Parse the blockstates for block info
       block_states_versions::post116(blockBitLength, blockStates,
@@ -206,7 +418,7 @@ void v3100(Section *target, const nbt::NBT &raw_section) {
     logger::trace("Section {} does not contain a palette, aborting", target->Y);
 }
 
-void catchall(Section *, const nbt::NBT &) {
+void catchall(Section *, const nbt::View &, const Colors::Index &) {
   logger::trace("Unsupported DataVersion");
 }
 } // namespace init_versions
@@ -4,23 +4,24 @@
 namespace mcmap {
 namespace versions {
 namespace block_states_versions {
-void post116(const uint8_t, const std::vector<int64_t> *,
-             Section::block_array &);
+// The packed block indexes, read straight from the chunk data
+using block_states_t = nbt::View::Array<int64_t>;
 
-void pre116(const uint8_t, const std::vector<int64_t> *,
-            Section::block_array &);
+void post116(const uint8_t, const block_states_t &, Section::block_array &);
+
+void pre116(const uint8_t, const block_states_t &, Section::block_array &);
 } // namespace block_states_versions
 
 namespace init_versions {
-void v1628(Section *, const nbt::NBT &);
+void v1628(Section *, const nbt::View &, const Colors::Index &);
 
-void v2534(Section *, const nbt::NBT &);
+void v2534(Section *, const nbt::View &, const Colors::Index &);
 
-void v2840(Section *, const nbt::NBT &);
+void v2840(Section *, const nbt::View &, const Colors::Index &);
 
-void v3100(Section *, const nbt::NBT &);
+void v3100(Section *, const nbt::View &, const Colors::Index &);
 
-void catchall(Section *, const nbt::NBT &);
+void catchall(Section *, const nbt::View &, const Colors::Index &);
 } // namespace init_versions
 } // namespace versions
 } // namespace mcmap
@@ -15,6 +15,7 @@ void printHelp(char *binary) {
       "  -file NAME            output file; default is 'output.png'\n"
       "  -colors NAME          color file to use; default is 'colors.json'\n"
       "  -nw -ne -se -sw       the orientation of the map\n"
+      "  -multiview            render the map in all four orientations\n"
       "  -nether               render the nether\n"
       "  -end                  render the end\n"
       "  -dim[ension] NAME     render a dimension by namespaced ID\n"
@@ -26,6 +27,11 @@ void printHelp(char *binary) {
       "  -fragment int (=1024) render terrain in tiles of the specified size\n"
       "  -tile int (=0)        if not 0, will create split output of the "
       "desired tile size\n"
+      "  -zoom int (=0)        number of zoomed out levels of tiles to "
+      "generate\n"
+      "  -incremental          only draw what changed since the last render\n"
+      "  -cache DIR            keep the decoded chunks in DIR for the next "
+      "renders\n"
       "  -marker X Z color     draw a marker at X Z of the desired color\n"
       "  -padding int (=5)     padding to use around the image\n"
       "  -h[elp]               display an option summary\n"
@@ -55,7 +55,7 @@ bool parseArgs(int argc, char **argv, Settings::WorldOptions *opts) {
           std::max(height, static_cast<int>(mcmap::constants::min_y));
     } else if (strcmp(option, "-padding") == 0) {
       if (!MOREARGS(1) || !isNumeric(POLLARG(1)) || atoi(POLLARG(1)) < 0) {
-        logger::error("{} needs an positive integer argument", option);
+        logger::error("{} needs a positive integer argument", option);
         return false;
       }
       opts->padding = atoi(NEXTARG);
@@ -124,6 +124,23 @@ bool parseArgs(int argc, char **argv, Settings::WorldOptions *opts) {
         return false;
       }
       opts->tile_size = atoi(NEXTARG);
+    } else if (strcmp(option, "-cache") == 0) {
+      if (!MOREARGS(1)) {
+        logger::error("{} needs one argument", option);
+        return false;
+      }
+      opts->chunkCache = NEXTARG;
+    } else if (strcmp(option, "-incremental") == 0) {
+      opts->incremental = true;
+    } else if (strcmp(option, "-multiview") == 0) {
+      opts->multiview = true;
+    } else if (strcmp(option, "-zoom") == 0) {
+      if (!MOREARGS(1) || !isNumeric(POLLARG(1)) || atoi(POLLARG(1)) < 0) {
+        logger::error("{} needs a positive integer argument", option);
+        return false;
+      }
+      opts->zoom_levels =
+          std::min(atoi(NEXTARG), int(Settings::ZOOM_LEVELS_MAX));
     } else if (strcmp(option, "-fragment") == 0) {
       if (!MOREARGS(1) || !isNumeric(POLLARG(1))) {
         logger::error("{} needs an integer", option);
@@ -198,6 +215,22 @@ bool parseArgs(int argc, char **argv, Settings::WorldOptions *opts) {
       return false;
     }
 
+    // Smaller fragments by default, as their chunks are kept until they are
+    // drawn in every orientation
+    if (opts->multiview &&
+        opts->fragment_size == Settings::FRAGMENT_SIZE_DEFAULT)
+      opts->fragment_size = Settings::MULTIVIEW_FRAGMENT_SIZE_DEFAULT;
+
+    if (opts->zoom_levels && !opts->tile_size) {
+      logger::error("Zoom levels need a tile size");
+      return false;
+    }
+
+    if (opts->zoom_levels && opts->tile_size % 2) {
+      logger::error("Zoom levels need an even tile size");
+      return false;
+    }
+
     if (opts->tile_size) {
       // In case tiling output has been queried
       // Forbid padding
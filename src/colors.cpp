@@ -1,7 +1,161 @@
 #include "colors.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 std::map<string, int> erroneous;
 
+namespace {
+// Blend rows of pixels, `top` over `bottom`, writing the result to
+// `destination`. With a and c the alpha and color of a pixel, t and b the top
+// and bottom pixels, blend() computes:
+//
+//   c = (ct * at + cb * (255 - at)) / 255
+//   a = ab + at * (255 - ab) / 255
+//
+// This also gives the bottom pixel when the top one is transparent, and the
+// top pixel when it is opaque: only transparent bottom pixels, giving the top
+// one, need a special case. When both are transparent, the destination is left
+// as is. The divisions by 255 are exact, computed for x <= 255 * 255 as
+// (x + 1 + (x >> 8)) >> 8 on 16 bits lanes.
+void compose(uint8_t *destination, const uint8_t *top, const uint8_t *bottom,
+             size_t count) {
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi16(1),
+                full = _mm256_set1_epi16(255),
+                alpha = _mm256_set1_epi64x(0xffff000000000000),
+                opacity = _mm256_set1_epi32(0xff000000);
+
+  auto div255 = [&](__m256i x) {
+    return _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(x, one), _mm256_srli_epi16(x, 8)),
+        8);
+  };
+
+  auto broadcast = [](__m256i x) {
+    return _mm256_shufflehi_epi16(
+        _mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)),
+        _MM_SHUFFLE(3, 3, 3, 3));
+  };
+
+  // Two pixels per 128 bits lane, on 16 bits channels
+  auto half = [&](__m256i t, __m256i b) {
+    const __m256i at = broadcast(t), ab = broadcast(b);
+
+    const __m256i color = div255(_mm256_add_epi16(
+        _mm256_mullo_epi16(t, at),
+        _mm256_mullo_epi16(b, _mm256_sub_epi16(full, at))));
+    const __m256i opaque = _mm256_add_epi16(
+        ab, div255(_mm256_mullo_epi16(at, _mm256_sub_epi16(full, ab))));
+
+    return _mm256_or_si256(_mm256_andnot_si256(alpha, color),
+                           _mm256_and_si256(alpha, opaque));
+  };
+
+  // 8 pixels per iteration
+  for (; i + 8 <= count; i += 8) {
+    const __m256i t = _mm256_loadu_si256((const __m256i *)(top + 4 * i));
+    const __m256i b = _mm256_loadu_si256((const __m256i *)(bottom + 4 * i));
+
+    const __m256i blended =
+        _mm256_packus_epi16(half(_mm256_unpacklo_epi8(t, zero),
+                                 _mm256_unpacklo_epi8(b, zero)),
+                            half(_mm256_unpackhi_epi8(t, zero),
+                                 _mm256_unpackhi_epi8(b, zero)));
+
+    const __m256i clear =
+        _mm256_cmpeq_epi32(_mm256_and_si256(b, opacity), zero);
+    const __m256i both = _mm256_and_si256(
+        clear, _mm256_cmpeq_epi32(_mm256_and_si256(t, opacity), zero));
+
+    __m256i *out = (__m256i *)(destination + 4 * i);
+    const __m256i result = _mm256_or_si256(
+        _mm256_and_si256(clear, t), _mm256_andnot_si256(clear, blended));
+
+    _mm256_storeu_si256(
+        out, _mm256_or_si256(_mm256_and_si256(both, _mm256_loadu_si256(out)),
+                             _mm256_andnot_si256(both, result)));
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi16(1),
+                full = _mm_set1_epi16(255),
+                alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0),
+                opacity = _mm_set1_epi32(0xff000000);
+
+  auto div255 = [&](__m128i x) {
+    return _mm_srli_epi16(
+        _mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8)), 8);
+  };
+
+  auto broadcast = [](__m128i x) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)),
+                               _MM_SHUFFLE(3, 3, 3, 3));
+  };
+
+  // Two pixels, on 16 bits channels
+  auto half = [&](__m128i t, __m128i b) {
+    const __m128i at = broadcast(t), ab = broadcast(b);
+
+    const __m128i color = div255(
+        _mm_add_epi16(_mm_mullo_epi16(t, at),
+                      _mm_mullo_epi16(b, _mm_sub_epi16(full, at))));
+    const __m128i opaque = _mm_add_epi16(
+        ab, div255(_mm_mullo_epi16(at, _mm_sub_epi16(full, ab))));
+
+    return _mm_or_si128(_mm_andnot_si128(alpha, color),
+                        _mm_and_si128(alpha, opaque));
+  };
+
+  // 4 pixels per iteration
+  for (; i + 4 <= count; i += 4) {
+    const __m128i t = _mm_loadu_si128((const __m128i *)(top + 4 * i));
+    const __m128i b = _mm_loadu_si128((const __m128i *)(bottom + 4 * i));
+
+    const __m128i blended = _mm_packus_epi16(
+        half(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(b, zero)),
+        half(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(b, zero)));
+
+    const __m128i clear = _mm_cmpeq_epi32(_mm_and_si128(b, opacity), zero);
+    const __m128i both = _mm_and_si128(
+        clear, _mm_cmpeq_epi32(_mm_and_si128(t, opacity), zero));
+
+    __m128i *out = (__m128i *)(destination + 4 * i);
+    const __m128i result = _mm_or_si128(_mm_and_si128(clear, t),
+                                        _mm_andnot_si128(clear, blended));
+
+    _mm_storeu_si128(out,
+                     _mm_or_si128(_mm_and_si128(both, _mm_loadu_si128(out)),
+                                  _mm_andnot_si128(both, result)));
+  }
+#endif
+
+  // The pixels left, or all of them without vector instructions
+  for (; i < count; i++) {
+    uint8_t pixel[4];
+
+    if (!top[4 * i + 3] && !bottom[4 * i + 3])
+      continue;
+
+    memcpy(pixel, bottom + 4 * i, 4);
+    blend(pixel, top + 4 * i);
+    memcpy(destination + 4 * i, pixel, 4);
+  }
+}
+} // namespace
+
+void blend(uint8_t *destination, const uint8_t *source, size_t count) {
+  compose(destination, source, destination, count);
+}
+
+void blend_under(uint8_t *destination, const uint8_t *source, size_t count) {
+  compose(destination, destination, source, count);
+}
+
 namespace Colors {
 // Embedded colors, as a byte array. This array is created by compiling
 // `colors.json` into `colors.bson`, using `json2bson`, then included here. The
@@ -59,6 +213,63 @@ bool Colors::load(Palette *colors, const fs::path &color_file) {
   return true;
 }
 
+namespace {
+// FNV-1a, over the bytes of a block name
+uint64_t name_hash(std::string_view name) {
+  uint64_t hash = 0xcbf29ce484222325;
+
+  for (const char c : name)
+    hash = (hash ^ uint8_t(c)) * 0x100000001b3;
+
+  return hash;
+}
+} // namespace
+
+Colors::Index::Index(const Palette &palette) : beacon(unknown) {
+  // Keep at least half of the slots free for the probes to stay short
+  size_t capacity = 16;
+  while (capacity < 2 * (palette.size() + 1))
+    capacity <<= 1;
+
+  slots.resize(capacity, unknown);
+  names.reserve(palette.size() + 1);
+  blocks.reserve(palette.size() + 1);
+
+  auto air_color = palette.find("minecraft:air");
+  insert("minecraft:air",
+         air_color != palette.end() ? air_color->second : Block());
+
+  for (const auto &defined : palette)
+    if (defined.first != "minecraft:air")
+      insert(defined.first, defined.second);
+
+  beacon = find("minecraft:beacon");
+}
+
+void Colors::Index::insert(const string &name, const Block &block) {
+  size_t slot = name_hash(name) & (slots.size() - 1);
+
+  while (slots[slot] != unknown)
+    slot = (slot + 1) & (slots.size() - 1);
+
+  slots[slot] = names.size();
+  names.push_back(name);
+  blocks.push_back(block);
+}
+
+Colors::Index::id_t Colors::Index::find(std::string_view name) const {
+  size_t slot = name_hash(name) & (slots.size() - 1);
+
+  while (slots[slot] != unknown) {
+    if (names[slots[slot]] == name)
+      return slots[slot];
+
+    slot = (slot + 1) & (slots.size() - 1);
+  }
+
+  return unknown;
+}
+
 void Colors::to_json(json &data, const Color &c) {
   data = fmt::format("{:c}", c);
 }
@@ -4,10 +4,13 @@
 #include "./helper.h"
 #include <filesystem>
 #include <json.hpp>
+#include <limits>
 #include <list>
 #include <logger.hpp>
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 using nlohmann::json;
 using std::list;
@@ -37,6 +40,13 @@ inline void blend(uint8_t *const destination, const uint8_t *const source) {
 #undef BLEND
 }
 
+// Blend `count` pixels of `source` over the pixels of `destination`, with the
+// same results as blend() pixel by pixel, several pixels at a time
+void blend(uint8_t *destination, const uint8_t *source, size_t count);
+
+// Blend `count` pixels of `source` under the pixels of `destination`
+void blend_under(uint8_t *destination, const uint8_t *source, size_t count);
+
 inline void addColor(uint8_t *const color, const uint8_t *const add) {
   const float v2 = (float(add[PALPHA]) / 255.0f);
   const float v1 = (1.0f - (v2 * .2f));
@@ -171,6 +181,22 @@ struct Block {
 
   bool operator!=(const Block &other) const { return !operator==(other); }
 
+  // Whether drawing the block overwrites every pixel of its sprite, hiding
+  // whatever was drawn there before
+  bool occludes() const {
+    switch (type) {
+    case FULL:
+      return primary.opaque();
+    case drawOre:
+    case drawGrown:
+    case drawLog:
+    case drawLamp:
+      return !primary.transparent();
+    default:
+      return false;
+    }
+  }
+
   Block shade(float fsub) const NOINLINE {
     Block shaded = *this;
 
@@ -185,6 +211,46 @@ struct Block {
 
 typedef map<string, Colors::Block> Palette;
 
+// Dense integer identifiers for the blocks of a palette
+//
+// The index is built once from a palette, and resolves block names through an
+// open-addressing hash table over the bytes of the name. Sections store the
+// identifiers and block pointers it returns, so looking a block up never
+// allocates a string nor walks the palette's tree.
+struct Index {
+  using id_t = uint32_t;
+
+  static constexpr id_t unknown = std::numeric_limits<id_t>::max();
+
+  // Air always gets the first identifier, even when missing from the palette,
+  // to check for empty sections without a lookup
+  static constexpr id_t air = 0;
+
+  // Identifier of the beacon block, if any
+  id_t beacon;
+
+  Index() : Index(Palette()){};
+  explicit Index(const Palette &);
+
+  // Get the identifier of a block from its namespaced name, or `unknown`
+  id_t find(std::string_view) const;
+
+  const Block *block(id_t id) const { return &blocks[id]; }
+  const string &name(id_t id) const { return names[id]; }
+
+  size_t size() const { return names.size(); }
+
+private:
+  std::vector<string> names;
+  std::vector<Block> blocks;
+
+  // Hash table of identifiers, `unknown` marking free slots; its size is a
+  // power of two
+  std::vector<id_t> slots;
+
+  void insert(const string &, const Block &);
+};
+
 struct Marker {
   int64_t x, z;
   Block color;
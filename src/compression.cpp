@@ -0,0 +1,290 @@
+#include "./compression.h"
+#include <algorithm>
+#include <cstring>
+#include <logger.hpp>
+
+#if defined(HAVE_LIBDEFLATE)
+#include <libdeflate.h>
+#elif defined(HAVE_ZLIB_NG)
+#include <zlib-ng.h>
+#define ZLIB(function) zng_##function
+using stream_t = zng_stream;
+#else
+#include <zlib.h>
+#define ZLIB(function) function
+using stream_t = z_stream;
+#endif
+
+namespace Compression {
+
+namespace {
+
+// The room made in the output when the size of the result is not known
+const size_t initial_size = 256 * 1024;
+
+// Make room for at least `needed` bytes in the output, at least doubling it
+void grow(std::vector<uint8_t> &output, size_t needed) {
+  if (output.size() < needed)
+    output.resize(std::max({needed, 2 * output.size(), initial_size}));
+}
+
+uint32_t little_endian(const uint8_t *data) {
+  return data[0] | data[1] << 8 | data[2] << 16 | uint32_t(data[3]) << 24;
+}
+
+// The size of the data of a gzip stream, as given by its trailer. It is only
+// trusted up to the best ratio deflate can achieve.
+size_t gzip_size(const uint8_t *data, size_t size) {
+  if (size < 18)
+    return 0;
+
+  return std::min<size_t>(little_endian(data + size - 4), 1032 * size);
+}
+
+#if defined(HAVE_LIBDEFLATE)
+
+struct Decompressor {
+  libdeflate_decompressor *state;
+
+  Decompressor() : state(libdeflate_alloc_decompressor()) {}
+  ~Decompressor() { libdeflate_free_decompressor(state); }
+};
+
+bool inflate(uint8_t type, const uint8_t *data, size_t size,
+             std::vector<uint8_t> &output, size_t *length) {
+  thread_local Decompressor decompressor;
+
+  if (!decompressor.state)
+    return false;
+
+  // The output grows until the whole result fits
+  grow(output, type == GZIP ? gzip_size(data, size) : 0);
+
+  while (true) {
+    const libdeflate_result result =
+        type == GZIP
+            ? libdeflate_gzip_decompress(decompressor.state, data, size,
+                                         output.data(), output.size(), length)
+            : libdeflate_zlib_decompress(decompressor.state, data, size,
+                                         output.data(), output.size(), length);
+
+    if (result == LIBDEFLATE_SUCCESS)
+      return true;
+
+    if (result != LIBDEFLATE_INSUFFICIENT_SPACE) {
+      logger::debug("Decompressing chunk data failed: libdeflate error {}",
+                    int(result));
+      return false;
+    }
+
+    grow(output, output.size() + 1);
+  }
+}
+
+#else
+
+struct Inflater {
+  stream_t stream;
+  bool ready;
+
+  // Both gzip and zlib headers are accepted
+  Inflater() : stream() {
+    ready = ZLIB(inflateInit2)(&stream, 32 + MAX_WBITS) == Z_OK;
+  }
+
+  ~Inflater() {
+    if (ready)
+      ZLIB(inflateEnd)(&stream);
+  }
+};
+
+bool inflate(uint8_t type, const uint8_t *data, size_t size,
+             std::vector<uint8_t> &output, size_t *length) {
+  thread_local Inflater inflater;
+  stream_t &stream = inflater.stream;
+
+  if (!inflater.ready || ZLIB(inflateReset)(&stream) != Z_OK)
+    return false;
+
+  grow(output, type == GZIP ? gzip_size(data, size) : 0);
+
+  stream.next_in = const_cast<uint8_t *>(data);
+  stream.avail_in = size;
+
+  size_t produced = 0;
+  int status;
+
+  // The output grows until the whole result fits
+  do {
+    grow(output, produced + 1);
+
+    stream.next_out = output.data() + produced;
+    stream.avail_out = output.size() - produced;
+
+    status = ZLIB(inflate)(&stream, Z_FINISH);
+    produced = output.size() - stream.avail_out;
+  } while ((status == Z_OK || status == Z_BUF_ERROR) && !stream.avail_out);
+
+  if (status != Z_STREAM_END) {
+    logger::debug("Decompressing chunk data failed: {}", ZLIB(zError)(status));
+    return false;
+  }
+
+  *length = produced;
+  return true;
+}
+
+#endif
+
+// Decode an LZ4 block into exactly `capacity` bytes
+bool lz4_block(const uint8_t *data, size_t size, uint8_t *output,
+               size_t capacity) {
+  const uint8_t *end = data + size;
+  uint8_t *position = output, *const limit = output + capacity;
+
+  // Lengths of 15 go on in the following bytes
+  auto extend = [&data, end](size_t &length) {
+    if (length != 15)
+      return true;
+
+    uint8_t byte;
+
+    do {
+      if (data == end)
+        return false;
+
+      byte = *data++;
+      length += byte;
+    } while (byte == 255);
+
+    return true;
+  };
+
+  while (data < end) {
+    const uint8_t token = *data++;
+    size_t literals = token >> 4;
+
+    if (!extend(literals) || size_t(end - data) < literals ||
+        size_t(limit - position) < literals)
+      return false;
+
+    memcpy(position, data, literals);
+    data += literals;
+    position += literals;
+
+    // The last sequence only holds literals
+    if (data == end)
+      break;
+
+    if (end - data < 2)
+      return false;
+
+    const size_t offset = data[0] | data[1] << 8;
+    size_t match = token & 0xf;
+    data += 2;
+
+    if (!extend(match))
+      return false;
+
+    match += 4;
+
+    if (!offset || offset > size_t(position - output) ||
+        size_t(limit - position) < match)
+      return false;
+
+    // The match can overlap the bytes it produces
+    const uint8_t *source = position - offset;
+    for (size_t i = 0; i < match; i++)
+      position[i] = source[i];
+
+    position += match;
+  }
+
+  return position == limit;
+}
+
+// Decode a stream of LZ4 blocks, as written by lz4-java: every block has a
+// header giving its method, its size before and after decompression and a
+// checksum, and an empty block closes the stream
+bool lz4(const uint8_t *data, size_t size, std::vector<uint8_t> &output,
+         size_t *length) {
+  const char magic[] = {'L', 'Z', '4', 'B', 'l', 'o', 'c', 'k'};
+  const size_t header = sizeof(magic) + 13;
+  const uint8_t raw = 0x10, compressed = 0x20;
+
+  size_t produced = 0;
+
+  while (size) {
+    if (size < header || memcmp(data, magic, sizeof(magic))) {
+      logger::debug("Decompressing chunk data failed: invalid LZ4 block");
+      return false;
+    }
+
+    const uint8_t method = data[sizeof(magic)] & 0xf0;
+    const size_t stored = little_endian(data + sizeof(magic) + 1),
+                 decoded = little_endian(data + sizeof(magic) + 5);
+
+    data += header;
+    size -= header;
+
+    if (!decoded)
+      break;
+
+    if (stored > size) {
+      logger::debug("Decompressing chunk data failed: truncated LZ4 block");
+      return false;
+    }
+
+    grow(output, produced + decoded);
+
+    if (method == raw && stored == decoded) {
+      memcpy(output.data() + produced, data, decoded);
+    } else if (method != compressed ||
+               !lz4_block(data, stored, output.data() + produced, decoded)) {
+      logger::debug("Decompressing chunk data failed: invalid LZ4 block");
+      return false;
+    }
+
+    produced += decoded;
+    data += stored;
+    size -= stored;
+  }
+
+  *length = produced;
+  return true;
+}
+
+} // namespace
+
+const char *backend() {
+#if defined(HAVE_LIBDEFLATE)
+  return "libdeflate";
+#elif defined(HAVE_ZLIB_NG)
+  return "zlib-ng";
+#else
+  return "zlib";
+#endif
+}
+
+bool decompress(uint8_t type, const uint8_t *data, size_t size,
+                std::vector<uint8_t> &output, size_t *length) {
+  switch (type) {
+  case GZIP:
+  case ZLIB:
+    return inflate(type, data, size, output, length);
+
+  case NONE:
+    grow(output, size);
+    memcpy(output.data(), data, size);
+    *length = size;
+    return true;
+
+  case LZ4:
+    return lz4(data, size, output, length);
+  }
+
+  logger::debug("Unsupported chunk compression: {}", type);
+  return false;
+}
+
+} // namespace Compression
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decompression of chunk data
+//
+// The data of a chunk is compressed with the method given by the byte that
+// precedes it in the region file. Deflate streams are inflated in one call by
+// libdeflate, or by zlib-ng, when either is found at build time, and by zlib
+// otherwise. Every thread keeps its decompressor from one chunk to the next.
+// LZ4 streams are decoded here, without any dependency.
+namespace Compression {
+
+enum Type : uint8_t {
+  GZIP = 1,
+  ZLIB = 2,
+  NONE = 3,
+  LZ4 = 4, // Written by lz4-java, since 1.20.5
+};
+
+// The library inflating deflate streams
+const char *backend();
+
+// Decompress `size` bytes of data compressed with `type` at the start of
+// `output`, growing it as needed, and set `length` to the size of the result
+bool decompress(uint8_t type, const uint8_t *data, size_t size,
+                std::vector<uint8_t> &output, size_t *length);
+
+} // namespace Compression
@@ -532,8 +532,13 @@ void Renderer::render() {
     emit sendProgress(d, t, a);
   };
 
+  auto report = [](const Statistics::Report &report) {
+    logger::info("Rendered in {:.2f}s, using {}MiB at most",
+                 report.elapsed / 1e9, report.peak_memory >> 20);
+  };
+
   emit startRender();
-  mcmap::render(options, custom_palette, update);
+  mcmap::render(options, custom_palette, update, report);
   emit resultReady();
 }
 
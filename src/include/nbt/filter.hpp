@@ -0,0 +1,48 @@
+#pragma once
+#ifndef NBT_FILTER_HPP_
+#define NBT_FILTER_HPP_
+
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace nbt {
+
+// Selection of the tags to keep when parsing NBT data
+//
+// A filter is a tree of tag names, mirroring the structure of the data to
+// parse. When parsing the contents of a compound, only the tags whose name
+// appear in the filter are kept, the others are skipped without being
+// allocated. A filter without children keeps the whole subtree it is applied
+// to. The elements of a list are all filtered with the list's filter.
+//
+// nbt::Filter({{"Level", {{"Status", {}}}}}) will only keep the `Status`
+// element of the `Level` compound from the data.
+struct Filter {
+  // Looked up by string views of the names read, without allocating
+  std::map<std::string, Filter, std::less<>> children;
+
+  Filter() {}
+  Filter(std::initializer_list<std::pair<const std::string, Filter>> l)
+      : children(l) {}
+
+  bool keeps_all() const { return children.empty(); }
+
+  // Get the filter to apply to the tag `name`, or nullptr if it is not to be
+  // kept
+  const Filter *find(std::string_view name) const {
+    auto query = children.find(name);
+
+    if (query == children.end())
+      return nullptr;
+
+    return &query->second;
+  }
+};
+
+} // namespace nbt
+
+#endif
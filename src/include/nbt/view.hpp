@@ -0,0 +1,449 @@
+#pragma once
+#ifndef NBT_VIEW_HPP_
+#define NBT_VIEW_HPP_
+
+#include <algorithm>
+#include <nbt/filter.hpp>
+#include <nbt/nbt.hpp>
+#include <stdexcept>
+#include <string_view>
+#include <translator.hpp>
+
+// Maximum nesting of containers accepted when indexing a buffer
+#define MAXVIEWDEPTH 512
+
+namespace nbt {
+
+// Read-only NBT tag, borrowing its data from the buffer it was indexed from
+//
+// Indexing a buffer only records where every tag is and the size of its
+// payload. Values are decoded from the big-endian buffer when accessed, and
+// arrays are never copied. A view is only valid as long as the buffer it was
+// indexed from is left untouched.
+class View {
+public:
+  // Array of big-endian elements in the buffer, decoded on access
+  template <typename T> struct Array {
+    const uint8_t *data;
+    size_t count;
+
+    Array() : data(nullptr), count(0){};
+    Array(const uint8_t *data, size_t count) : data(data), count(count){};
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+    T operator[](size_t index) const {
+      if constexpr (sizeof(T) == 1)
+        return T(data[index]);
+      else
+        return translate<T>(data + index * sizeof(T));
+    }
+  };
+
+  using children_t = std::vector<View>;
+  using const_iterator = children_t::const_iterator;
+
+  View() : type(tag_type::tag_end), payload(nullptr), length(0){};
+
+  tag_type get_type() const { return type; }
+  std::string_view get_name() const { return name; }
+
+  bool is_end() const { return type == tag_type::tag_end; }
+  bool is_list() const { return type == tag_type::tag_list; }
+  bool is_compound() const { return type == tag_type::tag_compound; }
+
+  // Number of elements in a container, array or string
+  size_t size() const {
+    return (is_list() || is_compound()) ? children.size() : length;
+  }
+
+  bool empty() const { return !size(); }
+
+  bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+  const View &operator[](std::string_view key) const {
+    const View *element = find(key);
+
+    if (!element)
+      throw(std::out_of_range("Key " + std::string(key) + " not found"));
+
+    return *element;
+  }
+
+  const View &operator[](size_t index) const {
+    if (!is_list())
+      throw(std::domain_error("Cannot use operator[] with a numeric argument "
+                              "on a tag that is not a list"));
+
+    return children.at(index);
+  }
+
+  const_iterator begin() const { return children.begin(); }
+  const_iterator end() const { return children.end(); }
+
+  template <typename ArithmeticType,
+            typename std::enable_if<std::is_arithmetic<ArithmeticType>::value,
+                                    int>::type = 0>
+  ArithmeticType get() const {
+    switch (type) {
+    case tag_type::tag_byte:
+      return static_cast<ArithmeticType>(int8_t(payload[0]));
+    case tag_type::tag_short:
+      return static_cast<ArithmeticType>(translate<int16_t>(payload));
+    case tag_type::tag_int:
+      return static_cast<ArithmeticType>(translate<int32_t>(payload));
+    case tag_type::tag_long:
+      return static_cast<ArithmeticType>(translate<int64_t>(payload));
+    case tag_type::tag_float:
+      return static_cast<ArithmeticType>(translate<float>(payload));
+    case tag_type::tag_double:
+      return static_cast<ArithmeticType>(translate<double>(payload));
+    default:
+      throw(std::invalid_argument(
+          fmt::format("Operation not available for tags of type `{}`",
+                      NBT(type).type_name())));
+    }
+  }
+
+  template <typename StringType,
+            typename std::enable_if<
+                std::is_same<StringType, std::string_view>::value ||
+                    std::is_same<StringType, std::string>::value,
+                int>::type = 0>
+  StringType get() const {
+    if (type != tag_type::tag_string)
+      throw(std::invalid_argument(
+          fmt::format("Operation not available for tags of type `{}`",
+                      NBT(type).type_name())));
+
+    return StringType(reinterpret_cast<const char *>(payload), length);
+  }
+
+  // Access the elements of a byte, int or long array, depending on the size
+  // of `T`
+  template <typename T> Array<T> array() const {
+    static_assert(sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8,
+                  "Array elements are 1, 4 or 8 bytes long");
+
+    const tag_type expected =
+        sizeof(T) == 1   ? tag_type::tag_byte_array
+        : sizeof(T) == 4 ? tag_type::tag_int_array
+                         : tag_type::tag_long_array;
+
+    if (type != expected)
+      throw(std::invalid_argument(
+          fmt::format("Operation not available for tags of type `{}`",
+                      NBT(type).type_name())));
+
+    return Array<T>(payload, length);
+  }
+
+  // Create an owned tree from the contents of the view
+  NBT nbt() const {
+    const std::string key(name);
+
+    switch (type) {
+    case tag_type::tag_end:
+      return NBT();
+    case tag_type::tag_byte:
+      return NBT(get<NBT::tag_byte_t>(), key);
+    case tag_type::tag_short:
+      return NBT(get<NBT::tag_short_t>(), key);
+    case tag_type::tag_int:
+      return NBT(get<NBT::tag_int_t>(), key);
+    case tag_type::tag_long:
+      return NBT(get<NBT::tag_long_t>(), key);
+    case tag_type::tag_float:
+      return NBT(get<NBT::tag_float_t>(), key);
+    case tag_type::tag_double:
+      return NBT(get<NBT::tag_double_t>(), key);
+    case tag_type::tag_string:
+      return NBT(get<std::string>(), key);
+    case tag_type::tag_byte_array:
+      return NBT(copy<NBT::tag_byte_array_t>(), key);
+    case tag_type::tag_int_array:
+      return NBT(copy<NBT::tag_int_array_t>(), key);
+    case tag_type::tag_long_array:
+      return NBT(copy<NBT::tag_long_array_t>(), key);
+
+    case tag_type::tag_list: {
+      NBT::tag_list_t elements;
+      elements.reserve(children.size());
+
+      for (const auto &child : children)
+        elements.push_back(child.nbt());
+
+      return NBT(std::move(elements), key);
+    }
+
+    case tag_type::tag_compound: {
+      NBT::tag_compound_t elements;
+
+      for (const auto &child : children)
+        elements.emplace(std::string(child.name), child.nbt());
+
+      return NBT(std::move(elements), key);
+    }
+    }
+
+    return NBT();
+  }
+
+  friend bool index(const uint8_t *, size_t, View &, const Filter *);
+
+private:
+  // Position in the buffer being indexed
+  struct Cursor {
+    const uint8_t *position, *end;
+
+    // Consume `num` bytes, returning their address or nullptr if there is not
+    // enough data left
+    const uint8_t *take(size_t num) {
+      if (size_t(end - position) < num) {
+        logger::error("Not enough data in memory buffer");
+        return nullptr;
+      }
+
+      const uint8_t *taken = position;
+      position += num;
+      return taken;
+    }
+  };
+
+  tag_type type;
+  std::string_view name;
+
+  // Address of the data of the tag in the buffer; after the size for arrays
+  // and strings
+  const uint8_t *payload;
+  // Number of elements of arrays, or length of strings
+  uint32_t length;
+
+  // Elements of lists and compounds
+  children_t children;
+
+  const View *find(std::string_view key) const {
+    if (!is_compound())
+      return nullptr;
+
+    // Compounds of interest are small enough for a linear search to beat any
+    // kind of index
+    for (const auto &child : children)
+      if (child.name == key)
+        return &child;
+
+    return nullptr;
+  }
+
+  template <typename Vector> Vector copy() const {
+    Array<typename Vector::value_type> elements =
+        array<typename Vector::value_type>();
+
+    Vector copy(elements.size());
+    for (size_t i = 0; i < elements.size(); i++)
+      copy[i] = elements[i];
+
+    return copy;
+  }
+
+  // Record the payload of a tag of type `tag` in `view`. If `view` is
+  // nullptr, the payload is skipped.
+  static bool read(Cursor &cursor, tag_type tag, const Filter *filter,
+                   View *view, uint16_t depth) {
+    const uint8_t *header;
+    size_t element_size = 0;
+
+    if (depth > MAXVIEWDEPTH) {
+      logger::error("NBT data is nested too deep");
+      return false;
+    }
+
+    if (view) {
+      view->type = tag;
+      view->payload = cursor.position;
+    }
+
+    switch (tag) {
+    case tag_type::tag_end:
+      return true;
+
+    case tag_type::tag_byte:
+      return cursor.take(1);
+
+    case tag_type::tag_short:
+      return cursor.take(2);
+
+    case tag_type::tag_int:
+    case tag_type::tag_float:
+      return cursor.take(4);
+
+    case tag_type::tag_long:
+    case tag_type::tag_double:
+      return cursor.take(8);
+
+    case tag_type::tag_string: {
+      if (!(header = cursor.take(2)))
+        return false;
+
+      const uint16_t characters = translate<uint16_t>(header);
+
+      if (view) {
+        view->payload = cursor.position;
+        view->length = characters;
+      }
+
+      return cursor.take(characters);
+    }
+
+    case tag_type::tag_byte_array:
+      element_size = 1;
+      break;
+
+    case tag_type::tag_int_array:
+      element_size = 4;
+      break;
+
+    case tag_type::tag_long_array:
+      element_size = 8;
+      break;
+
+    case tag_type::tag_list: {
+      if (!(header = cursor.take(5)))
+        return false;
+
+      const tag_type elements_type = tag_type(header[0]);
+      const uint32_t elements = translate<uint32_t>(header + 1);
+
+      // End tags take no room: their count cannot be checked against the data
+      if (elements_type == tag_type::tag_end && elements) {
+        logger::error("Invalid NBT list of {} end tags", elements);
+        return false;
+      }
+
+      if (view)
+        // Do not trust the element count to allocate memory
+        view->children.resize(
+            std::min(size_t(elements), size_t(cursor.end - cursor.position)));
+
+      for (uint32_t i = 0; i < elements; i++) {
+        View *element = nullptr;
+
+        if (view) {
+          if (i >= view->children.size())
+            view->children.emplace_back();
+          element = &view->children[i];
+        }
+
+        const uint8_t *start = cursor.position;
+
+        // An element using no data would not bring the loop closer to the end
+        if (!read(cursor, elements_type, filter, element, depth + 1) ||
+            cursor.position == start)
+          return false;
+      }
+
+      if (view && view->children.size() > elements)
+        view->children.resize(elements);
+
+      return true;
+    }
+
+    case tag_type::tag_compound: {
+      while (true) {
+        if (!(header = cursor.take(1)))
+          return false;
+
+        const tag_type element_type = tag_type(header[0]);
+
+        if (element_type == tag_type::tag_end)
+          return true;
+
+        if (!(header = cursor.take(2)))
+          return false;
+
+        const uint16_t name_size = translate<uint16_t>(header);
+        const uint8_t *element_name = cursor.take(name_size);
+
+        if (!element_name)
+          return false;
+
+        const std::string_view key(reinterpret_cast<const char *>(element_name),
+                                   name_size);
+
+        const Filter *element_filter = filter;
+        View *element = nullptr;
+
+        if (view && filter)
+          element_filter = filter->find(key);
+
+        // Only create views for the tags that are kept
+        if (view && (!filter || element_filter)) {
+          if (element_filter && element_filter->keeps_all())
+            element_filter = nullptr;
+
+          element = &view->children.emplace_back();
+          element->name = key;
+        }
+
+        if (!read(cursor, element_type, element_filter, element, depth + 1))
+          return false;
+      }
+    }
+
+    default:
+      logger::error("Unknown tag type {}", int(tag));
+      return false;
+    }
+
+    // Arrays
+    if (!(header = cursor.take(4)))
+      return false;
+
+    const uint32_t elements = translate<uint32_t>(header);
+
+    if (view) {
+      view->payload = cursor.position;
+      view->length = elements;
+    }
+
+    return cursor.take(element_size * elements);
+  }
+};
+
+// Index the NBT data in `buffer` into `root`. Only the tags selected by
+// `filter` are recorded, the others are skipped.
+inline bool index(const uint8_t *buffer, size_t size, View &root,
+                  const Filter *filter = nullptr) {
+  View::Cursor cursor = {buffer, buffer + size};
+  const uint8_t *header;
+
+  root = View();
+
+  if (!(header = cursor.take(3)))
+    return false;
+
+  const tag_type type = tag_type(header[0]);
+  const uint16_t name_size = translate<uint16_t>(header + 1);
+  const uint8_t *name = cursor.take(name_size);
+
+  if (type == tag_type::tag_end || !name)
+    return false;
+
+  root.name = std::string_view(reinterpret_cast<const char *>(name), name_size);
+
+  if (filter && filter->keeps_all())
+    filter = nullptr;
+
+  if (!View::read(cursor, type, filter, &root, 0)) {
+    logger::error("Error reading NBT data");
+    root = View();
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace nbt
+
+#endif
@@ -1,8 +1,10 @@
 #pragma once
+#include <atomic>
 #include <fmt/core.h>
 #include <functional>
 #include <logger.hpp>
 #include <map>
+#include <mutex>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -46,9 +48,13 @@ struct Status {
   };
 
   Callback notify;
-  size_t done, total;
+  std::atomic<size_t> done;
+  size_t total;
   Progress::Action type;
 
+  // Held by the thread reporting the progress
+  std::mutex reporting;
+
   Status(size_t total, Callback cb = quiet,
          Progress::Action action = Progress::RENDERING)
       : done(0), total(total), type(action) {
@@ -57,9 +63,18 @@ struct Status {
     notify(0, total, type);
   }
 
+  // Progress is counted from any thread without waiting. It is reported by
+  // one thread at a time, the others moving on without reporting, except for
+  // the end of the task that is always reported.
   void increment(size_t value = 1) {
-    done = std::min(done + value, total);
-    notify(done, total, type);
+    std::unique_lock<std::mutex> guard(reporting, std::defer_lock);
+
+    if ((done += value) >= total)
+      guard.lock();
+    else if (!guard.try_lock())
+      return;
+
+    notify(std::min(size_t(done), total), total, type);
   }
 };
 
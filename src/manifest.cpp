@@ -0,0 +1,181 @@
+#include "./manifest.h"
+#include "./VERSION"
+#include <fstream>
+
+namespace {
+
+// 64 bit FNV-1a hash, to get the same digests on every platform
+struct Digest {
+  uint64_t value;
+
+  Digest() : value(0xcbf29ce484222325) {}
+
+  void add(const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      value ^= data[i];
+      value *= 0x100000001b3;
+    }
+  }
+
+  void add(uint32_t number) {
+    const uint8_t bytes[4] = {uint8_t(number >> 24), uint8_t(number >> 16),
+                              uint8_t(number >> 8), uint8_t(number)};
+    add(bytes, 4);
+  }
+
+  void add(const std::string &text) {
+    add(reinterpret_cast<const uint8_t *>(text.data()), text.size());
+  }
+};
+
+// The chunk headers of a region file. Only the header is kept, as thousands of
+// regions can be looked up for a single render.
+struct Header {
+  std::array<Location, REGIONSIZE * REGIONSIZE> locations;
+  std::array<uint32_t, REGIONSIZE * REGIONSIZE> timestamps;
+};
+
+using Headers = std::map<std::pair<int32_t, int32_t>, Header>;
+
+const Header &header(Headers &headers, const fs::path &regionDir, int32_t x,
+                     int32_t z) {
+  auto query = headers.find({x, z});
+
+  if (query != headers.end())
+    return query->second;
+
+  // A missing region has an empty header
+  Region region(regionDir / fmt::format("r.{}.{}.mca", x, z));
+
+  return headers.emplace(std::make_pair(x, z),
+                         Header{region.locations, region.timestamps})
+      .first->second;
+}
+
+uint64_t chunks_digest(Headers &headers, const fs::path &regionDir,
+                       const World::Coordinates &fragment) {
+  Digest digest;
+
+  // The chunks around the fragment are included, as the blocks on its edges
+  // are drawn depending on their neighbours
+  for (int32_t x = CHUNK(fragment.minX) - 1; x <= CHUNK(fragment.maxX) + 1;
+       x++) {
+    for (int32_t z = CHUNK(fragment.minZ) - 1; z <= CHUNK(fragment.maxZ) + 1;
+         z++) {
+      const Header &region = header(headers, regionDir, REGION(x), REGION(z));
+      const uint16_t index = ((z & 0x1f) << 5) + (x & 0x1f);
+
+      digest.add(region.locations[index].raw_data);
+      digest.add(region.timestamps[index]);
+    }
+  }
+
+  return digest.value;
+}
+
+} // namespace
+
+Manifest::Manifest(const Settings::WorldOptions &options,
+                   const Colors::Palette &colors,
+                   const std::vector<World::Coordinates> &fragments) {
+  json drawing = options;
+
+  // Those options do not change the image
+  drawing.erase("mode");
+  drawing.erase("output");
+  drawing.erase("memory");
+  drawing.erase("incremental");
+  drawing.erase("cache");
+
+  drawing["fragment"] = options.fragment_size;
+  drawing["markers"] = json::array();
+  for (uint8_t i = 0; i < options.totalMarkers; i++)
+    drawing["markers"].push_back({options.markers[i].x, options.markers[i].z,
+                                  json(options.markers[i].color)});
+
+  Digest digest;
+  digest.add(VERSION);
+  digest.add(drawing.dump());
+  digest.add(json(colors).dump());
+  settings = fmt::format("{:016x}", digest.value);
+
+  Headers headers;
+  for (const auto &fragment : fragments)
+    this->fragments[fragment.to_string()].digest =
+        chunks_digest(headers, options.regionDir(), fragment);
+}
+
+fs::path Manifest::directory(const Settings::WorldOptions &options) {
+  if (options.tile_size)
+    return options.outFile / ".mcmap";
+
+  return options.outFile.parent_path() /
+         fmt::format(".{}.mcmap", options.outFile.filename().string());
+}
+
+fs::path Manifest::image(const fs::path &directory, const std::string &key) {
+  return directory / fmt::format("{}.packed", key);
+}
+
+bool Manifest::load(const fs::path &directory) {
+  const fs::path file = directory / "manifest.json";
+  std::ifstream input(file);
+
+  if (!input) {
+    logger::debug("No manifest found in `{}`", directory.string());
+    return false;
+  }
+
+  try {
+    json data = json::parse(input);
+
+    settings = data["settings"].get<std::string>();
+    map = data["map"].get<std::string>();
+
+    for (auto &fragment : data["fragments"].items()) {
+      fragments[fragment.key()].digest =
+          fragment.value()["digest"].get<uint64_t>();
+      fragments[fragment.key()].empty = fragment.value()["empty"].get<bool>();
+    }
+  } catch (const json::exception &err) {
+    logger::warn("Ignoring malformed manifest `{}`: {}", file.string(),
+                 err.what());
+    *this = Manifest();
+    return false;
+  }
+
+  return true;
+}
+
+bool Manifest::save(const fs::path &directory) const {
+  const fs::path file = directory / "manifest.json";
+  json data({{"settings", settings},
+             {"map", map},
+             {"fragments", json::object()}});
+
+  for (const auto &fragment : fragments)
+    data["fragments"][fragment.first] = {{"digest", fragment.second.digest},
+                                         {"empty", fragment.second.empty}};
+
+  std::ofstream output(file);
+  output << data.dump();
+
+  if (!output) {
+    logger::error("Failed to write manifest `{}`", file.string());
+    return false;
+  }
+
+  return true;
+}
+
+bool Manifest::unchanged(const Manifest &previous,
+                         const World::Coordinates &fragment) const {
+  const std::string key = fragment.to_string();
+  auto current = fragments.find(key), recorded = previous.fragments.find(key);
+
+  if (settings != previous.settings || current == fragments.end() ||
+      recorded == previous.fragments.end())
+    return false;
+
+  return current->second.digest == recorded->second.digest;
+}
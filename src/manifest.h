@@ -0,0 +1,48 @@
+#pragma once
+
+#include "./region.h"
+#include "./settings.h"
+#include <map.hpp>
+#include <string>
+
+// Record of a render, used to only draw again the parts of a map that changed
+// since the last time it was rendered
+//
+// Every fragment of the map is identified by its coordinates, and associated
+// with a digest of the chunks it is drawn from, combining their location and
+// modification time as recorded in the region headers. The fragments are kept
+// as packed images alongside the manifest; on the next render, the fragments
+// whose digest did not change are read back instead of being drawn again.
+struct Manifest {
+  struct Fragment {
+    uint64_t digest;
+    bool empty;
+
+    Fragment() : digest(0), empty(true){};
+  };
+
+  std::string settings; // Digest of the options the map was drawn with
+  std::string map;      // Coordinates of the composed image
+  // The fragments, by the string representation of their coordinates
+  std::map<std::string, Fragment> fragments;
+
+  Manifest(){};
+
+  // The settings the map is drawn with, and the digests of the chunks every
+  // fragment is made from
+  Manifest(const Settings::WorldOptions &, const Colors::Palette &,
+           const std::vector<World::Coordinates> &);
+
+  // Directory holding the manifest and the fragment images of an output
+  static fs::path directory(const Settings::WorldOptions &);
+
+  // Image of a fragment in the directory, from the fragment's key
+  static fs::path image(const fs::path &, const std::string &);
+
+  bool load(const fs::path &);
+  bool save(const fs::path &) const;
+
+  // Whether the fragment was drawn from the same chunks with the same settings
+  // in the `previous` render
+  bool unchanged(const Manifest &previous, const World::Coordinates &) const;
+};
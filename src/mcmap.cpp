@@ -1,20 +1,32 @@
 #include "./mcmap.h"
-#include <counter.hpp>
-
-#ifdef _OPENMP
-#define THREADS omp_get_max_threads()
-#else
-#define THREADS 1
-#endif
+#include "./compression.h"
+#include <atomic>
 
 namespace mcmap {
 
 bool writeMapInfo(fs::path outFile, const Canvas &finalImage,
-                  const uint32_t tileSize) {
+                  const uint32_t tileSize, const uint8_t zoomLevels) {
   json data({{"imageDimensions", {finalImage.width(), finalImage.height()}},
              {"layerLocation", outFile.string()},
              {"tileSize", tileSize}});
 
+  if (zoomLevels) {
+    // Every level halves the number of tiles of the level before, rounding up
+    size_t tilesX = (finalImage.width() + tileSize - 1) / tileSize,
+           tilesY = (finalImage.height() + tileSize - 1) / tileSize;
+
+    data["zoomLevels"] = zoomLevels;
+    data["levels"] = json::array();
+
+    for (uint8_t z = 0; z <= zoomLevels; z++) {
+      data["levels"].push_back({{"zoom", z},
+                                {"scale", 1.0 / (1 << z)},
+                                {"tiles", {tilesX, tilesY}}});
+      tilesX = (tilesX + 1) / 2;
+      tilesY = (tilesY + 1) / 2;
+    }
+  }
+
   fs::path infoFile = outFile / "mapinfo.json";
   std::ofstream infoStream;
 
@@ -32,81 +44,420 @@ bool writeMapInfo(fs::path outFile, const Canvas &finalImage,
   return true;
 }
 
+namespace {
+
+// The map as seen from one orientation: the fragments it is drawn from, and
+// the record of its last render in incremental mode
+struct View {
+  Settings::WorldOptions options;
+  std::vector<World::Coordinates> coordinates;
+  std::vector<Canvas> fragments;
+
+  fs::path history;
+  Manifest previous, current;
+  std::vector<uint8_t> redrawn;
+
+  View(const Settings::WorldOptions &o,
+       const std::vector<World::Coordinates> &fragments)
+      : options(o), coordinates(fragments), fragments(fragments.size()),
+        redrawn(fragments.size(), true) {}
+
+  // Look at the map from another direction
+  void orient(Map::Orientation orientation) {
+    options.boundaries.orientation = orientation;
+
+    for (auto &fragment : coordinates)
+      fragment.orientation = orientation;
+  }
+};
+
+std::string suffix(Map::Orientation orientation) {
+  switch (orientation) {
+  case Map::NW:
+    return "nw";
+  case Map::NE:
+    return "ne";
+  case Map::SE:
+    return "se";
+  case Map::SW:
+    return "sw";
+  }
+
+  return "";
+}
+
+// Take `amount` from a budget shared between threads, if that much is left
+bool spend(std::atomic<size_t> &budget, size_t amount) {
+  size_t left = budget;
+
+  while (left >= amount &&
+         !budget.compare_exchange_weak(left, left - amount)) {
+  }
+
+  return left >= amount;
+}
+
+// Compose the fragments of a view and write the result to its output
+bool compose(View &view, Progress::Callback cb) {
+  const Settings::WorldOptions &options = view.options;
+
+  CompositeCanvas merged(std::move(view.fragments));
+  logger::debug("{}", merged.to_string());
+
+  if (merged.empty()) {
+    logger::error("Canvas is empty !");
+    return false;
+  }
+
+  // The areas of the image covered by the fragments drawn again. If the image
+  // kept its place, only those have to be written again.
+  struct Area {
+    int64_t x, y, width, height;
+  };
+
+  std::vector<Area> changes;
+  const std::string composed = merged.map.to_string();
+  const bool partial = options.incremental && view.previous.map == composed &&
+                       view.previous.settings == view.current.settings;
+
+  for (size_t i = 0; i < view.coordinates.size(); i++) {
+    const World::Coordinates &fragment = view.coordinates[i];
+
+    if (view.redrawn[i])
+      changes.push_back({fragment.offsetX(merged.map),
+                         fragment.offsetY(merged.map),
+                         (fragment.sizeX() + fragment.sizeZ()) * 2,
+                         fragment.sizeX() + fragment.sizeZ() +
+                             (fragment.maxY - fragment.minY + 1) * BLOCKHEIGHT -
+                             1});
+  }
+
+  view.current.map = composed;
+
+  if (partial && changes.empty() &&
+      fs::exists(options.tile_size ? options.outFile / "mapinfo.json"
+                                   : options.outFile)) {
+    logger::info("Nothing changed since the last render");
+    return view.current.save(view.history);
+  }
+
+  logger::debug("{}/{} fragments drawn", changes.size(),
+                view.coordinates.size());
+
+  Canvas::TileFilter changed = nullptr;
+
+  if (partial)
+    changed = [&changes, &options](size_t x, size_t y) {
+      const int64_t size = options.tile_size, left = x * size, top = y * size;
+
+      for (const Area &area : changes)
+        if (area.x < left + size && left < area.x + area.width &&
+            area.y < top + size && top < area.y + area.height)
+          return true;
+
+      return false;
+    };
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  bool save_status;
+
+  {
+    // The lines of the image are composed while encoding it, that time is
+    // counted apart
+    Statistics::Timer timer(Statistics::ENCODE);
+
+    if (options.tile_size && writeMapInfo(options.outFile, merged,
+                                          options.tile_size,
+                                          options.zoom_levels)) {
+      save_status = merged.tile(options.outFile, options.tile_size,
+                                options.zoom_levels, cb, changed);
+    } else {
+      save_status = merged.save(options.outFile, options.padding, cb);
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+
+  if (!save_status)
+    return false;
+
+  if (options.incremental) {
+    // Forget about the fragments of another map
+    for (const auto &fragment : view.previous.fragments) {
+      std::error_code error;
+
+      if (!view.current.fragments.count(fragment.first))
+        fs::remove(Manifest::image(view.history, fragment.first), error);
+    }
+
+    if (!view.current.save(view.history))
+      return false;
+  }
+
+  logger::debug(
+      "Drawn PNG in {}ms",
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - begin)
+          .count());
+
+  return true;
+}
+
+// The report of a render goes next to its map information for tiled output,
+// or next to the image
+fs::path reportFile(const Settings::WorldOptions &options) {
+  if (options.tile_size)
+    return options.outFile / "report.json";
+
+  return options.outFile.parent_path() /
+         fmt::format("{}-report.json", options.outFile.stem().string());
+}
+
+} // namespace
+
 int render(const Settings::WorldOptions &options, const Colors::Palette &colors,
-           Progress::Callback cb) {
+           Progress::Callback cb, Statistics::Callback done) {
   logger::debug("Rendering {} with {}", options.save.name,
                 options.boundaries.to_string());
 
-  // Divide terrain according to fragment size
+  Statistics::Report &report = Statistics::current();
+  report.reset();
+
+  // Divide terrain around the existing chunks, in fragments no larger than
+  // the fragment size
   std::vector<World::Coordinates> fragment_coordinates;
-  options.boundaries.fragment(fragment_coordinates, options.fragment_size);
+  Planner planner(options.boundaries);
 
-  std::vector<Canvas> fragments(fragment_coordinates.size());
+  {
+    Statistics::Timer timer(Statistics::IO);
+    planner.scan(options.regionDir());
+  }
+
+  planner.fragment(fragment_coordinates, options.fragment_size);
+
+  if (fragment_coordinates.empty()) {
+    logger::error("No terrain to render in {}",
+                  options.boundaries.to_string());
+    return false;
+  }
+
+  // In multi-view mode, the map is drawn in every orientation from the same
+  // decoded chunks, each orientation going to its own output
+  std::vector<View> views;
+
+  if (options.multiview) {
+    for (Map::Orientation orientation : {Map::NW, Map::NE, Map::SE, Map::SW}) {
+      View view(options, fragment_coordinates);
+      view.orient(orientation);
+
+      if (options.tile_size) {
+        view.options.outFile = options.outFile / suffix(orientation);
+
+        std::error_code error;
+        fs::create_directory(view.options.outFile, error);
+        if (error) {
+          logger::error("Failed to create directory {}: {}",
+                        view.options.outFile.string(), error.message());
+          return false;
+        }
+      } else {
+        view.options.outFile = options.outFile;
+        view.options.outFile.replace_filename(fmt::format(
+            "{}-{}{}", options.outFile.stem().string(), suffix(orientation),
+            options.outFile.extension().string()));
+      }
+
+      views.push_back(std::move(view));
+    }
+  } else {
+    views.emplace_back(options, fragment_coordinates);
+  }
+
+  // The fragments differ in size, the memory is counted for the largest, in
+  // all the views
+  size_t footprint = 0;
+  for (size_t i = 0; i < fragment_coordinates.size(); i++) {
+    size_t views_footprint = 0;
+    for (const View &view : views)
+      views_footprint += IsometricCanvas::footprint(view.coordinates[i]);
+
+    footprint = std::max(footprint, views_footprint);
+  }
 
   Progress::Status s =
       Progress::Status(fragment_coordinates.size(), cb, Progress::RENDERING);
 
+  // The fragments are drawn by the workers of the scheduler, one task per
+  // fragment. Workers left without a fragment decode chunks for the others, a
+  // row of chunks at a time.
+  Scheduler scheduler;
+
   // This value represents the amount of canvasses that can fit in memory at
   // once to avoid going over the limit of RAM
-  Counter<size_t> capacity =
-      memory_capacity(options.mem_limit, fragment_coordinates[0].footprint(),
-                      fragment_coordinates.size(), THREADS);
+  const size_t capacity = memory_capacity(
+      options.mem_limit, footprint,
+      fragment_coordinates.size(), scheduler.size());
 
   if (!capacity)
     return false;
 
   logger::debug("Memory capacity: {} fragments - {} fragments scheduled",
-                size_t(capacity), fragment_coordinates.size());
+                capacity, fragment_coordinates.size());
 
   // If caching is needed, ensure the cache directory is available
-  if (capacity < fragments.size())
+  if (capacity < fragment_coordinates.size())
     if (!prepare_cache(getTempDir()))
       return false;
 
-  auto begin = std::chrono::high_resolution_clock::now();
-#ifdef _OPENMP
-#pragma omp parallel shared(fragments, capacity)
-#endif
-  {
-#ifdef _OPENMP
-#pragma omp for ordered schedule(dynamic)
-#endif
-    for (OMP_FOR_INDEX i = 0; i < fragment_coordinates.size(); i++) {
-      logger::debug("Rendering {}", fragment_coordinates[i].to_string());
-      IsometricCanvas canvas;
-      canvas.setMap(fragment_coordinates[i]);
-      canvas.setColors(colors);
+  // The memory left to keep the fragments drawn
+  std::atomic<size_t> budget(capacity * footprint);
 
-      // Load the minecraft terrain to render
-      Terrain::Data world(fragment_coordinates[i], options.regionDir(), colors);
+  // Block names are resolved through this index by all the fragments
+  const Colors::Index index(colors);
+  const ColorTables tables(index, options.shading, options.lighting);
+
+  // The chunks decoded by previous runs are read back from the cache, if any
+  std::unique_ptr<Terrain::ChunkCache> cache;
+
+  if (!options.chunkCache.empty()) {
+    if (!prepare_cache(options.chunkCache))
+      return false;
+
+    cache = std::make_unique<Terrain::ChunkCache>(options.chunkCache,
+                                                  options.regionDir());
+  }
+
+  // In incremental mode, the fragments drawn from chunks that did not change
+  // since the last render are read back from the images it left
+  if (options.incremental) {
+    for (View &view : views) {
+      view.history = Manifest::directory(view.options);
+
+      if (!prepare_cache(view.history))
+        return false;
+
+      view.previous.load(view.history);
+      view.current = Manifest(view.options, colors, view.coordinates);
+    }
+  }
+
+  // Draw a fragment in all the views it is needed in
+  auto draw = [&](size_t i) {
+    // The views this fragment has to be drawn in
+    std::vector<View *> pending;
+
+    for (View &view : views) {
+      const std::string key = view.coordinates[i].to_string();
+      const fs::path image = Manifest::image(view.history, key);
+
+      if (options.incremental &&
+          view.current.unchanged(view.previous, view.coordinates[i])) {
+        const bool empty = view.previous.fragments.at(key).empty;
+        Canvas kept;
+
+        if (!empty && fs::exists(image)) {
+          Statistics::Timer timer(Statistics::IO);
+          kept = PackedCanvas(view.coordinates[i], image);
+        }
+
+        if (empty || kept.type == Canvas::PACKED) {
+          logger::debug("Re-using {}", key);
+          Statistics::count(Statistics::FRAGMENTS_REUSED);
+
+          if (!empty)
+            view.fragments[i] = std::move(kept);
+          view.current.fragments.at(key).empty = empty;
+          view.redrawn[i] = false;
+          continue;
+        }
+      }
+
+      pending.push_back(&view);
+    }
+
+    if (pending.empty()) {
+      s.increment();
+      return;
+    }
+
+    // Load the minecraft terrain to render, keeping the chunks if they are
+    // drawn more than once
+    Terrain::Data world(pending.front()->coordinates[i], options.regionDir(),
+                        index, &scheduler, cache.get(), pending.size() > 1);
+
+    for (View *view : pending) {
+      const std::string key = view->coordinates[i].to_string();
+      const fs::path image = Manifest::image(view->history, key);
+
+      logger::debug("Rendering {}", key);
+      IsometricCanvas canvas;
+      canvas.setMap(view->coordinates[i]);
+      canvas.setColors(colors, &tables);
 
       // Draw the terrain fragment
       canvas.shading = options.shading;
       canvas.lighting = options.lighting;
       canvas.setMarkers(options.totalMarkers, options.markers);
-      canvas.renderTerrain(world);
-
-      if (!canvas.empty()) {
-        if (i >= capacity) {
-          fs::path temporary = getTempDir() / canvas.map.to_string();
-          canvas.save(temporary);
 
-          fragments[i] = std::move(ImageCanvas(canvas.map, temporary));
-        } else
-          fragments[i] = std::move(canvas);
-      } else {
-        // If the canvas was empty, increase the capacity to reflect the free
-        // space
-        if (i < capacity)
-          ++capacity;
+      {
+        Statistics::Timer timer(Statistics::DRAW);
+        canvas.renderTerrain(world);
       }
 
-#ifdef _OPENMP
-#pragma omp critical
-#endif
-      { s.increment(); }
+      Statistics::count(Statistics::FRAGMENTS_DRAWN);
+      Statistics::Timer timer(Statistics::SPILL);
+
+      if (options.incremental) {
+        // The fragment is kept for the next render
+        if (!canvas.empty()) {
+          Statistics::count(Statistics::FRAGMENTS_PACKED);
+
+          if (PackedCanvas(canvas).image().save(image))
+            view->fragments[i] = PackedCanvas(canvas.map, image);
+          else
+            view->fragments[i] = std::move(canvas);
+        } else {
+          std::error_code error;
+          fs::remove(image, error);
+        }
+
+        view->current.fragments.at(key).empty = canvas.empty();
+      } else if (!canvas.empty()) {
+        // Empty fragments take no memory. The others are kept as drawn
+        // while the budget allows, then packed; packed fragments go to a
+        // scratch file once the budget is spent.
+        if (spend(budget, canvas.drawing.sparse_buffer->memory())) {
+          view->fragments[i] = std::move(canvas);
+        } else {
+          PackedCanvas packed(canvas);
+          const fs::path scratch =
+              getTempDir() / fmt::format("{}.packed", canvas.map.to_string());
+
+          Statistics::count(Statistics::FRAGMENTS_PACKED);
+
+          if (!spend(budget, packed.image().memory())) {
+            if (packed.image().spill(scratch))
+              Statistics::count(Statistics::SPILLS);
+            else
+              logger::warn("Failed to spill fragment {} to {}, keeping it "
+                           "in memory over the limit",
+                           canvas.map.to_string(), scratch.string());
+          }
+
+          view->fragments[i] = std::move(packed);
+        }
+      }
     }
-  }
+
+    s.increment();
+  };
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < fragment_coordinates.size(); i++)
+    scheduler.submit([&draw, i] { draw(i); });
+
+  scheduler.run();
 
   auto end = std::chrono::high_resolution_clock::now();
 
@@ -115,34 +466,22 @@ int render(const Settings::WorldOptions &options, const Colors::Palette &colors,
       std::chrono::duration_cast<std::chrono::milliseconds>(end - begin)
           .count());
 
-  CompositeCanvas merged(std::move(fragments));
-  logger::debug("{}", merged.to_string());
+  report.busy = scheduler.busy();
+  report.drawing =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+          .count();
 
-  if (merged.empty()) {
-    logger::error("Canvas is empty !");
-    return false;
-  }
-
-  begin = std::chrono::high_resolution_clock::now();
-
-  bool save_status;
-
-  if (options.tile_size &&
-      writeMapInfo(options.outFile, merged, options.tile_size)) {
-    save_status = merged.tile(options.outFile, options.tile_size, cb);
-  } else {
-    save_status = merged.save(options.outFile, options.padding, cb);
-  }
-
-  end = std::chrono::high_resolution_clock::now();
+  for (View &view : views)
+    if (!compose(view, cb))
+      return false;
 
-  if (!save_status)
-    return false;
+  // The report goes along the output; failing to write it does not fail the
+  // render
+  report.finish();
+  report.save(reportFile(options));
 
-  logger::debug(
-      "Drawn PNG in {}ms",
-      std::chrono::duration_cast<std::chrono::milliseconds>(end - begin)
-          .count());
+  if (done)
+    done(report);
 
   return true;
 }
@@ -171,6 +510,7 @@ std::map<std::string, std::string> compilation_options() {
 #ifdef ZLIB_VERSION
       {"zlib version", ZLIB_VERSION},
 #endif
+      {"Chunk decompression", Compression::backend()},
 #ifdef SCM_COMMIT
       {"Source version", SCM_COMMIT},
 #endif
@@ -3,14 +3,20 @@
 
 #include "./VERSION"
 #include "./canvas.h"
+#include "./manifest.h"
+#include "./planner.h"
+#include "./scheduler.h"
 #include "./settings.h"
-#include <omp.h>
+#include "./statistics.h"
 #include <progress.hpp>
 
 namespace mcmap {
 
+// Render a map. A report of the time spent in every stage of the render is
+// written along the output, and handed to the statistics callback if any.
 int render(const Settings::WorldOptions &, const Colors::Palette &,
-           Progress::Callback = Progress::Status::quiet);
+           Progress::Callback = Progress::Status::quiet,
+           Statistics::Callback = nullptr);
 
 std::string version();
 
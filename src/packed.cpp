@@ -0,0 +1,305 @@
+#include "./packed.h"
+#include "./canvas.h"
+#include "./statistics.h"
+
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool same(const uint8_t *lhs, const uint8_t *rhs) {
+  return !memcmp(lhs, rhs, BYTESPERPIXEL);
+}
+
+// The size of the header of a file of `height` lines, before the packed data
+size_t header_size(uint64_t height) {
+  return 4 + 2 * sizeof(uint64_t) + height * sizeof(uint64_t);
+}
+
+} // namespace
+
+PackedImage::PackedImage(size_t width, size_t height)
+    : width(width), height(height), header(0), size(0)
+#ifndef _WINDOWS
+      ,
+      mapping(nullptr), mapping_size(0)
+#else
+      ,
+      temporary(false)
+#endif
+{
+  lines.reserve(height);
+}
+
+PackedImage::PackedImage(const std::filesystem::path &file)
+    : PackedImage(0, 0) {
+  open(file, false);
+}
+
+PackedImage::~PackedImage() {
+#ifndef _WINDOWS
+  if (mapping)
+    munmap(const_cast<uint8_t *>(mapping), mapping_size);
+#else
+  input.close();
+
+  if (temporary) {
+    std::error_code error;
+    std::filesystem::remove(file, error);
+  }
+#endif
+}
+
+void PackedImage::put(Run run, size_t length, const uint8_t *pixels) {
+  const uint16_t tag = (length << 2) | run;
+
+  contents.push_back(tag & 0xff);
+  contents.push_back(tag >> 8);
+
+  if (run == REPEAT)
+    contents.insert(contents.end(), pixels, pixels + BYTESPERPIXEL);
+  else if (run == COPY)
+    contents.insert(contents.end(), pixels, pixels + length * BYTESPERPIXEL);
+}
+
+void PackedImage::add(const uint8_t *line) {
+  lines.push_back(contents.size());
+
+  auto pixel = [line](size_t x) { return line + x * BYTESPERPIXEL; };
+
+  // Whether the pixel at x starts a run of 3 pixels of the same color
+  auto repeated = [&](size_t x) {
+    return x + 2 < width && same(pixel(x), pixel(x + 1)) &&
+           same(pixel(x), pixel(x + 2));
+  };
+
+  for (size_t x = 0, length; x < width; x += length) {
+    const size_t end = std::min(width, x + longest);
+    length = 1;
+
+    if (!pixel(x)[3]) {
+      while (x + length < end && !pixel(x + length)[3])
+        length++;
+
+      put(SKIP, length, nullptr);
+    } else if (repeated(x)) {
+      while (x + length < end && same(pixel(x), pixel(x + length)))
+        length++;
+
+      put(REPEAT, length, pixel(x));
+    } else {
+      while (x + length < end && pixel(x + length)[3] && !repeated(x + length))
+        length++;
+
+      put(COPY, length, pixel(x));
+    }
+  }
+}
+
+bool PackedImage::save(const std::filesystem::path &destination) const {
+  // Only the images packed in memory can be written
+  if (!valid() || header) {
+    logger::error("Cannot save incomplete packed image to `{}`",
+                  destination.string());
+    return false;
+  }
+
+  const uint64_t dimensions[2] = {width, height};
+
+  std::ofstream output(destination, std::ofstream::binary);
+  output.write(magic, sizeof(magic));
+  output.write(reinterpret_cast<const char *>(dimensions),
+               sizeof(dimensions));
+  output.write(reinterpret_cast<const char *>(lines.data()),
+               lines.size() * sizeof(uint64_t));
+  output.write(reinterpret_cast<const char *>(contents.data()),
+               contents.size());
+  output.close();
+
+  if (!output) {
+    std::error_code error;
+    logger::error("Failed to write packed image `{}`", destination.string());
+    std::filesystem::remove(destination, error);
+    return false;
+  }
+
+  Statistics::count(Statistics::BYTES_WRITTEN,
+                    header_size(height) + contents.size());
+  return true;
+}
+
+bool PackedImage::spill(const std::filesystem::path &destination) {
+  return save(destination) && open(destination, true);
+}
+
+bool PackedImage::open(const std::filesystem::path &source, bool scratch) {
+  std::error_code error;
+  uint64_t dimensions[2];
+
+#ifndef _WINDOWS
+  int descriptor = ::open(source.string().c_str(), O_RDONLY);
+  struct stat status;
+
+  void *address = MAP_FAILED;
+  size_t length = 0;
+
+  if (descriptor != -1 && !fstat(descriptor, &status) && status.st_size) {
+    length = status.st_size;
+    address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  }
+
+  // The mapping keeps a reference to the file, that is not needed anymore
+  if (descriptor != -1)
+    close(descriptor);
+  if (scratch)
+    std::filesystem::remove(source, error);
+
+  if (address == MAP_FAILED) {
+    logger::error("Mapping packed image `{}` failed: {}", source.string(),
+                  strerror(errno));
+    return false;
+  }
+
+  const uint8_t *data = static_cast<const uint8_t *>(address);
+
+  if (length >= header_size(0))
+    memcpy(dimensions, data + sizeof(magic), sizeof(dimensions));
+
+  if (length < header_size(0) || memcmp(data, magic, sizeof(magic)) ||
+      dimensions[1] > length / sizeof(uint64_t) ||
+      length < header_size(dimensions[1])) {
+    logger::error("Invalid packed image `{}`", source.string());
+    munmap(address, length);
+    return false;
+  }
+
+  lines.resize(dimensions[1]);
+  memcpy(lines.data(), data + header_size(0),
+         dimensions[1] * sizeof(uint64_t));
+
+  mapping = data;
+  mapping_size = length;
+#else
+  const size_t length = std::filesystem::file_size(source, error);
+  char signature[sizeof(magic)];
+
+  input.open(source, std::ifstream::binary);
+  input.read(signature, sizeof(signature));
+  input.read(reinterpret_cast<char *>(dimensions), sizeof(dimensions));
+
+  if (error || !input || memcmp(signature, magic, sizeof(magic)) ||
+      dimensions[1] > length / sizeof(uint64_t) ||
+      length < header_size(dimensions[1])) {
+    logger::error("Invalid packed image `{}`", source.string());
+    input.close();
+    if (scratch)
+      std::filesystem::remove(source, error);
+    return false;
+  }
+
+  lines.resize(dimensions[1]);
+  input.read(reinterpret_cast<char *>(lines.data()),
+             dimensions[1] * sizeof(uint64_t));
+
+  file = source;
+  temporary = scratch;
+#endif
+
+  width = dimensions[0];
+  height = dimensions[1];
+  header = header_size(height);
+  size = length - header;
+
+  // A line outside of the file would be read past its end
+  for (uint64_t offset : lines)
+    if (offset > size) {
+      logger::error("Invalid packed image `{}`", source.string());
+      lines.clear();
+      return false;
+    }
+
+  contents.clear();
+  contents.shrink_to_fit();
+
+  Statistics::count(Statistics::BYTES_READ, length);
+  return true;
+}
+
+void PackedImage::blend(uint64_t y, uint8_t *buffer, size_t count) const {
+  if (y >= lines.size())
+    return;
+
+  const size_t total = header ? size : contents.size();
+  const size_t end = y + 1 < lines.size() ? lines[y + 1] : total;
+
+  if (end < lines[y])
+    return;
+
+#ifndef _WINDOWS
+  const uint8_t *data = header ? mapping + header : contents.data();
+  const uint8_t *position = data + lines[y], *last = data + end;
+#else
+  const uint8_t *position = contents.data() + lines[y],
+                *last = contents.data() + end;
+
+  // Every thread reads the lines it needs in its own buffer
+  thread_local std::vector<uint8_t> line;
+
+  if (header) {
+    line.resize(end - lines[y]);
+
+    {
+      std::lock_guard<std::mutex> lock(reading);
+      input.seekg(header + lines[y]);
+      input.read(reinterpret_cast<char *>(line.data()), line.size());
+    }
+
+    position = line.data();
+    last = line.data() + line.size();
+  }
+#endif
+
+  for (size_t x = 0; position + 2 <= last && x < count;) {
+    const uint16_t tag = position[0] | (position[1] << 8);
+    const Run run = Run(tag & 0x3);
+    const size_t length = tag >> 2, visible = std::min(length, count - x);
+    position += 2;
+
+    // A truncated run ends the line
+    if (run != SKIP &&
+        size_t(last - position) < (run == REPEAT ? 1 : length) * BYTESPERPIXEL)
+      break;
+
+    switch (run) {
+    case SKIP:
+      break;
+
+    case REPEAT: {
+      // The color is repeated in a short line, blended a piece at a time
+      uint8_t repeated[64 * BYTESPERPIXEL];
+      const size_t piece = std::min(visible, size_t(64));
+
+      for (size_t i = 0; i < piece; i++)
+        memcpy(repeated + i * BYTESPERPIXEL, position, BYTESPERPIXEL);
+
+      for (size_t i = 0; i < visible; i += piece)
+        overlay(repeated, buffer + (x + i) * BYTESPERPIXEL,
+                std::min(piece, visible - i));
+
+      position += BYTESPERPIXEL;
+      break;
+    }
+
+    case COPY:
+      overlay(position, buffer + x * BYTESPERPIXEL, visible);
+      position += length * BYTESPERPIXEL;
+      break;
+    }
+
+    x += length;
+  }
+}
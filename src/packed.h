@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#ifdef _WINDOWS
+#include <mutex>
+#endif
+
+// Packed image
+//
+// Fragments that do not fit in the memory budget were saved as PNG images and
+// read back while composing, paying for a deflate and an inflate on disk. They
+// are packed instead with a codec cheap enough to decode every time a line is
+// read: each line is a list of runs, of transparent pixels skipped, of pixels
+// of a single color, or of pixels copied as is.
+//
+// The packed lines are kept in memory, or written to a file mapped back when
+// there is no memory left for them. The file starts with the offset of every
+// line, so any line can be read on its own, from any thread:
+//
+// +--------+-------+--------+-----------------+-------+-------+-----+
+// | "MCPK" | width | height | offsets[height] | line0 | line1 | ... |
+// +--------+-------+--------+-----------------+-------+-------+-----+
+struct PackedImage {
+  // The size of the image, in pixels
+  size_t width, height;
+
+  PackedImage(size_t width, size_t height);
+
+  // Map the image saved in `file`; the image is invalid if it could not be
+  // read
+  explicit PackedImage(const std::filesystem::path &file);
+
+  ~PackedImage();
+
+  PackedImage(const PackedImage &) = delete;
+  PackedImage &operator=(const PackedImage &) = delete;
+
+  // Whether all the lines of the image are available
+  bool valid() const { return height && lines.size() == height; }
+
+  // Pack the next line of the image, `width` pixels long
+  void add(const uint8_t *line);
+
+  // The memory used by the packed lines, if they are not in a file
+  size_t memory() const { return contents.size(); }
+
+  // Write the image to `file`
+  bool save(const std::filesystem::path &file) const;
+
+  // Write the image to `file` and read it from there from now on, releasing
+  // the memory of the packed lines. The file is removed once not needed.
+  bool spill(const std::filesystem::path &file);
+
+  // Blend the first `count` pixels of line `y` under the pixels in `buffer`
+  void blend(uint64_t y, uint8_t *buffer, size_t count) const;
+
+private:
+  enum Run : uint8_t { SKIP, REPEAT, COPY };
+
+  // A run is a 16 bits header, holding its type and its length, followed by
+  // the pixels of the run if any
+  static constexpr size_t longest = 0x3fff;
+
+  static constexpr char magic[4] = {'M', 'C', 'P', 'K'};
+
+  // The offset of every line in the packed data
+  std::vector<uint64_t> lines;
+  std::vector<uint8_t> contents;
+
+  // The packed data, when read from a file
+  size_t header, size;
+
+#ifndef _WINDOWS
+  const uint8_t *mapping;
+  size_t mapping_size;
+#else
+  // No mmap on windows, the lines are read from the file instead, one thread
+  // at a time
+  std::filesystem::path file;
+  bool temporary;
+  mutable std::ifstream input;
+  mutable std::mutex reading;
+#endif
+
+  // Read the image from `file`, removing the file once opened if `temporary`
+  bool open(const std::filesystem::path &file, bool temporary);
+
+  void put(Run, size_t length, const uint8_t *pixels);
+};
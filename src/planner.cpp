@@ -0,0 +1,150 @@
+#include "./planner.h"
+
+namespace {
+
+// A rectangle of chunks, relative to the first chunk of the map
+struct Area {
+  size_t minX, minZ, maxX, maxZ;
+
+  size_t sizeX() const { return maxX - minX + 1; }
+  size_t sizeZ() const { return maxZ - minZ + 1; }
+
+  // The part of the area from `first` to `last` along x, or along z
+  Area slice(bool alongX, size_t first, size_t last) const {
+    return alongX ? Area{first, minZ, last, maxZ}
+                  : Area{minX, first, maxX, last};
+  }
+};
+
+// Amount of chunks present in any area, from the amount of chunks in every
+// area starting at the first chunk of the map
+struct Counts {
+  size_t width;
+  std::vector<uint32_t> sums;
+
+  Counts(const std::vector<bool> &present, size_t sizeX, size_t sizeZ)
+      : width(sizeX + 1), sums((sizeX + 1) * (sizeZ + 1), 0) {
+    for (size_t z = 0; z < sizeZ; z++)
+      for (size_t x = 0; x < sizeX; x++)
+        sums[(z + 1) * width + x + 1] = present[z * sizeX + x] +
+                                        sums[z * width + x + 1] +
+                                        sums[(z + 1) * width + x] -
+                                        sums[z * width + x];
+  }
+
+  size_t count(const Area &area) const {
+    return sums[(area.maxZ + 1) * width + area.maxX + 1] -
+           sums[area.minZ * width + area.maxX + 1] -
+           sums[(area.maxZ + 1) * width + area.minX] +
+           sums[area.minZ * width + area.minX];
+  }
+};
+
+// Shrink a non-empty area to the chunks it holds
+Area shrink(const Counts &counts, Area area) {
+  while (!counts.count(area.slice(true, area.minX, area.minX)))
+    area.minX++;
+  while (!counts.count(area.slice(true, area.maxX, area.maxX)))
+    area.maxX--;
+  while (!counts.count(area.slice(false, area.minZ, area.minZ)))
+    area.minZ++;
+  while (!counts.count(area.slice(false, area.maxZ, area.maxZ)))
+    area.maxZ--;
+
+  return area;
+}
+
+void split(const Counts &counts, const Area &area, size_t size,
+           std::vector<Area> &parts) {
+  const size_t total = counts.count(area);
+
+  if (!total)
+    return;
+
+  const Area shrunk = shrink(counts, area);
+
+  if (shrunk.sizeX() <= size && shrunk.sizeZ() <= size) {
+    parts.push_back(shrunk);
+    return;
+  }
+
+  // Cut along the longest side, leaving half the chunks on each side
+  const bool alongX = shrunk.sizeX() >= shrunk.sizeZ();
+  const size_t first = alongX ? shrunk.minX : shrunk.minZ,
+               last = alongX ? shrunk.maxX : shrunk.maxZ;
+
+  size_t cut = first;
+  while (cut + 1 < last &&
+         2 * counts.count(shrunk.slice(alongX, first, cut)) < total)
+    cut++;
+
+  split(counts, shrunk.slice(alongX, first, cut), size, parts);
+  split(counts, shrunk.slice(alongX, cut + 1, last), size, parts);
+}
+
+} // namespace
+
+Planner::Planner(const World::Coordinates &boundaries)
+    : boundaries(boundaries), originX(CHUNK(boundaries.minX)),
+      originZ(CHUNK(boundaries.minZ)), sizeX(0), sizeZ(0) {
+  if (boundaries.maxX < boundaries.minX || boundaries.maxZ < boundaries.minZ)
+    return;
+
+  sizeX = CHUNK(boundaries.maxX) - originX + 1;
+  sizeZ = CHUNK(boundaries.maxZ) - originZ + 1;
+
+  present.resize(sizeX * sizeZ, false);
+}
+
+void Planner::add(int32_t x, int32_t z) {
+  if (x < originX || z < originZ || size_t(x - originX) >= sizeX ||
+      size_t(z - originZ) >= sizeZ)
+    return;
+
+  present[(z - originZ) * sizeX + (x - originX)] = true;
+}
+
+void Planner::scan(const fs::path &regionDir) {
+  if (!sizeX || !sizeZ)
+    return;
+
+  const int32_t lastX = originX + int32_t(sizeX) - 1,
+                lastZ = originZ + int32_t(sizeZ) - 1;
+
+  for (int32_t rx = REGION(originX); rx <= REGION(lastX); rx++) {
+    for (int32_t rz = REGION(originZ); rz <= REGION(lastZ); rz++) {
+      // A missing region has an empty header
+      const Region region(regionDir / fmt::format("r.{}.{}.mca", rx, rz));
+
+      for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++)
+        if (region.locations[chunk].raw_data)
+          add((rx << 5) + (chunk & 0x1f), (rz << 5) + (chunk >> 5));
+    }
+  }
+}
+
+void Planner::fragment(std::vector<World::Coordinates> &fragments,
+                       size_t size) const {
+  if (!sizeX || !sizeZ)
+    return;
+
+  std::vector<Area> parts;
+  split(Counts(present, sizeX, sizeZ), {0, 0, sizeX - 1, sizeZ - 1},
+        std::max(size_t(1), size / CHUNKSIZE), parts);
+
+  for (const Area &part : parts) {
+    World::Coordinates fragment = boundaries;
+
+    // Back to blocks, without going over the boundaries of the map
+    fragment.minX = std::max(boundaries.minX,
+                             int32_t(originX + part.minX) * CHUNKSIZE);
+    fragment.maxX = std::min(boundaries.maxX,
+                             int32_t(originX + part.maxX + 1) * CHUNKSIZE - 1);
+    fragment.minZ = std::max(boundaries.minZ,
+                             int32_t(originZ + part.minZ) * CHUNKSIZE);
+    fragment.maxZ = std::min(boundaries.maxZ,
+                             int32_t(originZ + part.maxZ + 1) * CHUNKSIZE - 1);
+
+    fragments.push_back(fragment);
+  }
+}
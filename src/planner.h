@@ -0,0 +1,40 @@
+#pragma once
+
+#include "./region.h"
+#include <map.hpp>
+#include <vector>
+
+// Fragment planner
+//
+// Cutting the map in squares of a fixed size leaves sparse worlds with many
+// fragments holding few chunks or none, each allocating a whole canvas, while
+// a fragment over a dense area takes much longer to draw than the others. The
+// planner marks the chunks present in the region headers, and cuts the map
+// around them: the area of the map is split in two at the median of its
+// chunks, along its longest side, until every part fits in a fragment. Each
+// part is then shrunk to the chunks it holds, and parts without chunks are
+// left out.
+struct Planner {
+  // The map to cut, in blocks
+  World::Coordinates boundaries;
+
+  // Create a planner for the map, with no chunks present
+  explicit Planner(const World::Coordinates &);
+
+  // Mark the chunks present in the region files of `regionDir`
+  void scan(const fs::path &regionDir);
+
+  // Mark the chunk at the given chunk coordinates as present
+  void add(int32_t x, int32_t z);
+
+  // Cut the map in fragments at most `size` blocks wide
+  void fragment(std::vector<World::Coordinates> &, size_t size) const;
+
+private:
+  // The first chunk of the map, and the size of the map in chunks
+  int32_t originX, originZ;
+  size_t sizeX, sizeZ;
+
+  // Whether every chunk of the map is present, by row of x
+  std::vector<bool> present;
+};
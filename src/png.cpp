@@ -3,7 +3,16 @@
  */
 
 #include "png.h"
+#include "statistics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 #include <vector>
+#include <zlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifndef Z_BEST_SPEED
 #define Z_BEST_SPEED 6
@@ -87,6 +96,9 @@ void PNGWriter::_close() {
   png_write_end(pngPtr, NULL);
   png_destroy_write_struct(&pngPtr, &pngInfoPtr);
 
+  if (imageHandle)
+    Statistics::count(Statistics::BYTES_WRITTEN, ftell(imageHandle));
+
   super::_close();
 }
 
@@ -196,6 +208,276 @@ uint32_t PNGWriter::writeLine() {
   return row_size();
 }
 
+namespace {
+
+const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+// Size of the uncompressed data of a band
+const size_t band_size = 4 * 1024 * 1024;
+
+void put_uint32(uint8_t *destination, uint32_t value) {
+  destination[0] = value >> 24;
+  destination[1] = value >> 16;
+  destination[2] = value >> 8;
+  destination[3] = value;
+}
+
+// Filter `row` into `filtered`, using the filter type that gives the lowest sum
+// of absolute differences, as libpng does. `prior` is the row above.
+void filter(const uint8_t *row, const uint8_t *prior, size_t stride,
+            uint8_t *filtered, std::vector<uint8_t> &scratch) {
+  const size_t bpp = 4;
+  uint8_t *candidates[5];
+  uint64_t best_sum = std::numeric_limits<uint64_t>::max();
+  uint8_t best = 0;
+
+  scratch.resize(5 * stride);
+
+  for (uint8_t type = 0; type < 5; type++) {
+    uint8_t *out = candidates[type] = &scratch[type * stride];
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < stride; i++) {
+      const int a = i < bpp ? 0 : row[i - bpp], b = prior[i],
+                c = i < bpp ? 0 : prior[i - bpp];
+      int predictor = 0;
+
+      switch (type) {
+      case 1:
+        predictor = a;
+        break;
+      case 2:
+        predictor = b;
+        break;
+      case 3:
+        predictor = (a + b) / 2;
+        break;
+      case 4: {
+        const int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+        predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+        break;
+      }
+      }
+
+      out[i] = uint8_t(row[i] - predictor);
+      sum += abs(int8_t(out[i]));
+    }
+
+    if (sum < best_sum) {
+      best_sum = sum;
+      best = type;
+    }
+  }
+
+  filtered[0] = best;
+  memcpy(filtered + 1, candidates[best], stride);
+}
+
+struct Band {
+  std::vector<uint8_t> data;
+  uint32_t adler, crc;
+  size_t length;
+};
+
+// Filter and deflate `count` rows into a band of the image data. The band ends
+// on a byte boundary, or terminates the stream if it is the `last` one.
+bool encode(const uint8_t *prior, const uint8_t *rows, size_t count,
+            size_t stride, bool last, Band &band) {
+  std::vector<uint8_t> filtered(count * (stride + 1)), scratch;
+
+  for (size_t i = 0; i < count; i++) {
+    filter(rows + i * stride, i ? rows + (i - 1) * stride : prior, stride,
+           &filtered[i * (stride + 1)], scratch);
+  }
+
+  band.length = filtered.size();
+  band.adler = adler32(adler32(0L, Z_NULL, 0), filtered.data(), band.length);
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(z_stream));
+
+  // Raw deflate: the stream header and checksum are written separately
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+
+  // A sync flush adds an empty block after the data
+  band.data.resize(deflateBound(&stream, band.length) + 16);
+
+  stream.next_in = filtered.data();
+  stream.avail_in = band.length;
+  stream.next_out = band.data.data();
+  stream.avail_out = band.data.size();
+
+  const int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  band.data.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  if (status != (last ? Z_STREAM_END : Z_OK) || stream.avail_in) {
+    logger::error("[ParallelWriter] Compressing image data failed: {}",
+                  zError(status));
+    return false;
+  }
+
+  band.crc = crc32(crc32(crc32(0L, Z_NULL, 0), (const Bytef *)"IDAT", 4),
+                   band.data.data(), band.data.size());
+
+  return true;
+}
+
+} // namespace
+
+ParallelWriter::ParallelWriter(const std::filesystem::path &file,
+                               uint32_t width, uint32_t height,
+                               const Comments &comments, size_t rows_per_band)
+    : file(file), handle(nullptr), width(width), height(height), written(0),
+      adler(adler32(0L, Z_NULL, 0)) {
+  stride = size_t(width) * 4;
+  band_rows = rows_per_band ? rows_per_band
+                            : std::max(size_t(1),
+                                       band_size / std::max(stride, size_t(1)));
+#ifdef _OPENMP
+  bands = omp_get_max_threads();
+#else
+  bands = 1;
+#endif
+
+  if (!(width && height)) {
+    logger::warn("[ParallelWriter] Nothing to output: canvas is empty !");
+    return;
+  }
+
+  logger::trace("[ParallelWriter] image {}x{}, {} bands of {} rows, writing "
+                "to {}",
+                width, height, bands, band_rows, file.string());
+
+  if (!(handle = fopen(file.string().c_str(), "wb"))) {
+    logger::error("[ParallelWriter] Error opening '{}' for writing: {}",
+                  file.string(), strerror(errno));
+    return;
+  }
+
+  rows.resize(std::min(batch(), size_t(height)) * stride, 0);
+  previous.resize(stride, 0);
+
+  // 8 bits RGBA, no interlacing
+  uint8_t header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0};
+  put_uint32(header, width);
+  put_uint32(header + 4, height);
+
+  fwrite(signature, 1, sizeof(signature), handle);
+  chunk("IHDR", header, sizeof(header));
+
+  for (auto const &pair : comments) {
+    std::vector<uint8_t> text(pair.first.begin(), pair.first.end());
+    text.push_back(0);
+    text.insert(text.end(), pair.second.begin(), pair.second.end());
+    chunk("tEXt", text.data(), text.size());
+  }
+
+  // Header of the zlib stream, for deflate with the default compression level
+  const uint8_t stream_header[2] = {0x78, 0x9c};
+  chunk("IDAT", stream_header, sizeof(stream_header));
+}
+
+ParallelWriter::~ParallelWriter() {
+  if (handle)
+    fclose(handle);
+}
+
+bool ParallelWriter::chunk(const char *type, const uint8_t *data,
+                           size_t length) {
+  uint8_t size[4], crc[4];
+  put_uint32(size, length);
+  uint32_t checksum = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)type, 4);
+
+  // zlib resets the checksum when given no data
+  if (length)
+    checksum = crc32(checksum, data, length);
+
+  put_uint32(crc, checksum);
+
+  return fwrite(size, 1, 4, handle) == 4 && fwrite(type, 1, 4, handle) == 4 &&
+         fwrite(data, 1, length, handle) == length &&
+         fwrite(crc, 1, 4, handle) == 4;
+}
+
+bool ParallelWriter::commit(size_t count) {
+  if (!handle || !count)
+    return false;
+
+  count = std::min({count, batch(), height - written});
+
+  const size_t used = (count + band_rows - 1) / band_rows;
+  const bool last = written + count == height;
+
+  std::vector<Band> encoded(used);
+  bool success = true;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(&& : success)
+#endif
+  for (int band = 0; band < int(used); band++) {
+    const size_t first = band * band_rows;
+    const size_t length = std::min(band_rows, count - first);
+    const uint8_t *prior =
+        first ? &rows[(first - 1) * stride] : previous.data();
+
+    success = encode(prior, &rows[first * stride], length, stride,
+                     last && size_t(band) == used - 1, encoded[band]) &&
+              success;
+  }
+
+  if (!success)
+    return false;
+
+  for (const Band &band : encoded) {
+    uint8_t size[4], crc[4];
+    put_uint32(size, band.data.size());
+    put_uint32(crc, band.crc);
+
+    if (fwrite(size, 1, 4, handle) != 4 || fwrite("IDAT", 1, 4, handle) != 4 ||
+        fwrite(band.data.data(), 1, band.data.size(), handle) !=
+            band.data.size() ||
+        fwrite(crc, 1, 4, handle) != 4) {
+      logger::error("[ParallelWriter] Error writing to '{}'", file.string());
+      return false;
+    }
+
+    adler = adler32_combine(adler, band.adler, band.length);
+  }
+
+  // Keep the last row for the filters of the next batch, and blank the rows
+  memcpy(previous.data(), &rows[(count - 1) * stride], stride);
+  memset(rows.data(), 0, count * stride);
+  written += count;
+
+  return true;
+}
+
+bool ParallelWriter::close() {
+  if (!handle)
+    return false;
+
+  bool success = written == height;
+
+  if (!success)
+    logger::error("[ParallelWriter] Image '{}' is incomplete: {}/{} rows",
+                  file.string(), written, height);
+  else {
+    uint8_t checksum[4];
+    put_uint32(checksum, adler);
+
+    success = chunk("IDAT", checksum, 4) && chunk("IEND", nullptr, 0);
+  }
+
+  Statistics::count(Statistics::BYTES_WRITTEN, ftell(handle));
+  fclose(handle);
+  handle = nullptr;
+
+  return success;
+}
+
 PNGReader::PNGReader(const std::filesystem::path &file) : PNG(file) {
   _open();
   _close();
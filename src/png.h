@@ -7,6 +7,7 @@
 #include <map>
 #include <png.h>
 #include <string>
+#include <vector>
 
 namespace PNG {
 
@@ -101,6 +102,53 @@ private:
   typedef PNG super;
 };
 
+// Writer encoding bands of rows concurrently
+//
+// The rows are handed over in batches. A batch is cut in bands, which are
+// filtered and deflated on all the threads available, then written in order as
+// IDAT chunks. Each band is a byte-aligned piece of the same deflate stream,
+// and the adler32 checksum of the stream is combined from the checksums of the
+// bands. The file is written directly, without going through libpng.
+struct ParallelWriter {
+  const std::filesystem::path file;
+
+  // The height of the bands is chosen from the width of the image if none is
+  // given
+  ParallelWriter(const std::filesystem::path &, uint32_t, uint32_t,
+                 const Comments & = {}, size_t = 0);
+  ~ParallelWriter();
+
+  bool is_open() const { return handle != nullptr; }
+
+  // Maximum number of rows in a batch
+  size_t batch() const { return bands * band_rows; }
+
+  // Row `index` of the current batch, blank when handed over
+  uint8_t *row(size_t index) { return &rows[index * stride]; }
+
+  // Encode and write the `count` first rows of the batch
+  bool commit(size_t count);
+
+  // Finish the image and close the file
+  bool close();
+
+private:
+  FILE *handle;
+  uint32_t width, height;
+
+  // Size of a row in bytes, number of bands in a batch and rows in a band
+  size_t stride, bands, band_rows;
+
+  // Rows written so far
+  size_t written;
+  // Checksum of the uncompressed data written so far
+  uint32_t adler;
+
+  std::vector<uint8_t> rows, previous;
+
+  bool chunk(const char *, const uint8_t *, size_t);
+};
+
 struct PNGReader : public PNG {
 
   PNGReader(const std::filesystem::path &);
@@ -1,6 +1,15 @@
 #include "./region.h"
+#include <algorithm>
+#include <sstream>
 
-uint32_t _ntohi(uint8_t *val) {
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint32_t _ntohi(const uint8_t *val) {
   return (uint32_t(val[0]) << 24) + (uint32_t(val[1]) << 16) +
          (uint32_t(val[2]) << 8) + (uint32_t(val[3]));
 }
@@ -23,24 +32,139 @@ std::pair<int32_t, int32_t> Region::coordinates(const fs::path &_file) {
   return {rX, rZ};
 }
 
-Region::Region(const fs::path &_file) : file(_file) {
-  locations.fill(Location());
+Region::Region(const fs::path &_file) : Region() {
+  file = _file;
+
+  if (!map())
+    return;
+
+  if (mapping_size < REGION_HEADER_SIZE) {
+    logger::error("Error reading `{}` header.", file.string());
+    unmap();
+    return;
+  }
+
+  // The header is parsed once, the chunk data will then be accessed through
+  // the mapping
+  for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++)
+    locations[chunk].raw_data = _ntohi(mapping + chunk * 4);
+
+  // The timestamps follow the locations; a truncated table is ignored
+  if (mapping_size >= 2 * REGION_HEADER_SIZE)
+    for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++)
+      timestamps[chunk] = _ntohi(mapping + REGION_HEADER_SIZE + chunk * 4);
+}
+
+Region &Region::operator=(Region &&other) {
+  unmap();
+
+  file = std::move(other.file);
+  locations = other.locations;
+  timestamps = other.timestamps;
+
+  mapping = other.mapping;
+  mapping_size = other.mapping_size;
+#ifdef _WINDOWS
+  contents = std::move(other.contents);
+#endif
+
+  other.mapping = nullptr;
+  other.mapping_size = 0;
+
+  return *this;
+}
+
+bool Region::map() {
+  std::error_code error;
+  const uintmax_t size = fs::file_size(file, error);
+
+  if (error) {
+    logger::trace("Region file `{}` cannot be accessed: {}", file.string(),
+                  error.message());
+    return false;
+  }
+
+  if (!size) {
+    logger::trace("Region file `{}` is empty", file.string());
+    return false;
+  }
+
+#ifndef _WINDOWS
+  int descriptor = open(file.string().c_str(), O_RDONLY);
+
+  if (descriptor == -1) {
+    logger::error("Opening region file `{}` failed: {}", file.string(),
+                  strerror(errno));
+    return false;
+  }
+
+  void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
 
+  // The mapping keeps a reference to the file, the descriptor is useless from
+  // now on
+  close(descriptor);
+
+  if (address == MAP_FAILED) {
+    logger::error("Mapping region file `{}` failed: {}", file.string(),
+                  strerror(errno));
+    return false;
+  }
+
+  mapping = static_cast<const uint8_t *>(address);
+#else
   std::ifstream regionData(file, std::ifstream::binary);
+  contents.resize(size);
 
-  for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++) {
-    char buffer[4];
-    regionData.read(buffer, 4);
+  if (!regionData.read(reinterpret_cast<char *>(contents.data()), size)) {
+    logger::error("Reading region file `{}` failed", file.string());
+    contents.clear();
+    return false;
+  }
 
-    locations[chunk].raw_data = _ntohi((uint8_t *)buffer);
+  mapping = contents.data();
+#endif
 
-    if (!regionData) {
-      logger::error("Error reading `{}` header.", _file.string());
-      break;
-    }
+  mapping_size = size;
+  return true;
+}
+
+void Region::unmap() {
+  if (!mapping)
+    return;
+
+#ifndef _WINDOWS
+  munmap(const_cast<uint8_t *>(mapping), mapping_size);
+#else
+  contents.clear();
+  contents.shrink_to_fit();
+#endif
+
+  mapping = nullptr;
+  mapping_size = 0;
+}
+
+ChunkData Region::chunk(uint16_t chunk) const {
+  if (!mapping || chunk >= REGIONSIZE * REGIONSIZE)
+    return ChunkData();
+
+  const size_t offset = size_t(locations[chunk].offset()) * 4096;
+
+  // The 5 first bytes give the size and compression type of the data
+  if (!offset || offset + 5 > mapping_size)
+    return ChunkData();
+
+  const uint8_t *header = mapping + offset;
+
+  // The length includes the compression byte
+  const size_t length = _ntohi(header);
+
+  if (length < 1 || offset + 4 + length > mapping_size) {
+    logger::debug("Chunk {} overflows from region file `{}`", chunk,
+                  file.string());
+    return ChunkData();
   }
 
-  regionData.close();
+  return ChunkData(header + 5, length - 1, header[4]);
 }
 
 void Region::write(const fs::path &_file) {
@@ -51,10 +175,10 @@ void Region::write(const fs::path &_file) {
     out.write((char *)&bytes, 4);
   }
 
-  std::array<char, 4 * REGIONSIZE * REGIONSIZE> timestamps;
-  timestamps.fill(0);
-
-  out.write(&timestamps[0], 4 * REGIONSIZE * REGIONSIZE);
+  for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++) {
+    uint32_t bytes = _ntohi((uint8_t *)&timestamps[chunk]);
+    out.write((char *)&bytes, 4);
+  }
 }
 
 size_t Region::get_offset(uint8_t max_size) {
@@ -1,4 +1,7 @@
+#pragma once
+
 #include "./helper.h"
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
@@ -23,19 +26,66 @@ struct Location {
   }
 };
 
+// A view on the compressed data of a chunk, as stored in a region file. The
+// pointer points into the region's mapping and is only valid as long as the
+// region it was obtained from lives.
+struct ChunkData {
+  const uint8_t *data;
+  size_t size;
+  uint8_t compression;
+
+  ChunkData() : data(nullptr), size(0), compression(0){};
+  ChunkData(const uint8_t *data, size_t size, uint8_t compression)
+      : data(data), size(size), compression(compression){};
+
+  bool empty() const { return !data || !size; }
+};
+
 struct Region {
   static std::pair<int32_t, int32_t> coordinates(const fs::path &);
 
   fs::path file;
   std::array<Location, REGIONSIZE * REGIONSIZE> locations;
+  // Last modification of every chunk, in seconds since the epoch
+  std::array<uint32_t, REGIONSIZE * REGIONSIZE> timestamps;
 
-  Region() { locations.fill(Location()); }
+  Region() : mapping(nullptr), mapping_size(0) {
+    locations.fill(Location());
+    timestamps.fill(0);
+  }
 
+  // Map the file in memory and parse its header. If the file does not exist
+  // or is malformed, the region is left empty and `valid()` returns false.
   Region(const fs::path &);
 
+  Region(const Region &) = delete;
+  Region(Region &&other) : Region() { *this = std::move(other); }
+  ~Region() { unmap(); }
+
+  Region &operator=(const Region &) = delete;
+  Region &operator=(Region &&);
+
+  bool valid() const { return mapping != nullptr; }
+
+  // Return a view on the compressed data of the chunk of index `chunk` (x +
+  // 32 * z), or an empty view if the chunk is not present in the file
+  ChunkData chunk(uint16_t chunk) const;
+
   void write(const fs::path &);
 
   size_t get_offset(uint8_t);
+
+private:
+  const uint8_t *mapping;
+  size_t mapping_size;
+
+#ifdef _WINDOWS
+  // No mmap on windows, the file is read in this buffer instead
+  std::vector<uint8_t> contents;
+#endif
+
+  bool map();
+  void unmap();
 };
 
 template <> struct fmt::formatter<Region> {
@@ -110,9 +110,6 @@ void to_json(json &j, const SaveFile &s) {
 }
 
 World::Coordinates SaveFile::getWorld(const Dimension &dim) {
-  const char delimiter = '.';
-  std::string index;
-  char buffer[4];
   int32_t regionX, regionZ;
 
   World::Coordinates savedWorld;
@@ -121,27 +118,15 @@ World::Coordinates SaveFile::getWorld(const Dimension &dim) {
   if (region(dim).empty())
     return savedWorld;
 
-  for (auto &region : fs::directory_iterator(region(dim))) {
-    // This loop parses files with name 'r.x.y.mca', extracting x and y. This is
-    // done by creating a string stream and using `getline` with '.' as a
-    // delimiter.
-    std::stringstream ss(region.path().filename().string());
-    std::getline(ss, index, delimiter); // This removes the 'r.'
-    std::getline(ss, index, delimiter);
+  for (auto &file : fs::directory_iterator(region(dim))) {
+    // Extract x and z from the file name 'r.x.z.mca'
+    std::tie(regionX, regionZ) = Region::coordinates(file.path());
 
-    regionX = atoi(index.c_str());
+    const Region data(file.path());
 
-    std::getline(ss, index, delimiter);
-
-    regionZ = atoi(index.c_str());
-
-    std::ifstream regionData(region.path());
     for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++) {
-      regionData.read(buffer, 4);
-
-      if (*((uint32_t *)&buffer) == 0) {
+      if (!data.locations[chunk].raw_data)
         continue;
-      }
 
       savedWorld.minX =
           std::min(savedWorld.minX, int32_t((regionX << 5) + (chunk & 0x1f)));
@@ -1,4 +1,5 @@
 #include "./helper.h"
+#include "./region.h"
 #include <filesystem>
 #include <fstream>
 #include <json.hpp>
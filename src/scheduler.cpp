@@ -0,0 +1,145 @@
+#include "./scheduler.h"
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// The scheduler the current thread works for, and its index in it
+thread_local const Scheduler *owner = nullptr;
+thread_local size_t current = 0;
+
+} // namespace
+
+Scheduler::Scheduler(size_t threads)
+    : queued(0), pending(0), idle(0), next(0), stopping(false) {
+  if (!threads)
+    threads = concurrency();
+
+  for (size_t i = 0; i < threads; i++)
+    queues.push_back(std::make_unique<Queue>());
+
+  for (size_t i = 1; i < threads; i++)
+    workers.emplace_back([this, i] { work(i, [this] { return stopping; }); });
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+
+  available.notify_all();
+
+  for (auto &worker : workers)
+    worker.join();
+}
+
+size_t Scheduler::concurrency() {
+#ifdef _OPENMP
+  // Follow OMP_NUM_THREADS, as the parts of the program using OpenMP do
+  return std::max(1, omp_get_max_threads());
+#else
+  return std::max(1u, std::thread::hardware_concurrency());
+#endif
+}
+
+void Scheduler::submit(Task &&task) {
+  const size_t worker = owner == this ? current : next++ % queues.size();
+
+  pending++;
+
+  {
+    std::lock_guard<std::mutex> guard(queues[worker]->lock);
+    queues[worker]->tasks.push_back(std::move(task));
+  }
+
+  queued++;
+
+  // Taking the lock makes sure a worker about to wait sees the new task
+  { std::lock_guard<std::mutex> guard(lock); }
+  available.notify_one();
+}
+
+bool Scheduler::take(size_t worker, Task *task) {
+  {
+    Queue &own = *queues[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued--;
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < queues.size(); i++) {
+    Queue &other = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(other.lock);
+
+    if (!other.tasks.empty()) {
+      *task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Scheduler::work(size_t worker, const std::function<bool()> &done) {
+  const Scheduler *previous = owner;
+  owner = this;
+  current = worker;
+
+  Task task;
+
+  while (true) {
+    if (take(worker, &task)) {
+      const auto begin = std::chrono::steady_clock::now();
+
+      task();
+      task = nullptr;
+
+      queues[worker]->busy +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - begin)
+              .count();
+
+      if (!--pending) {
+        { std::lock_guard<std::mutex> guard(lock); }
+        available.notify_all();
+      }
+
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    if (done())
+      break;
+
+    idle++;
+    available.wait(guard, [this, &done] { return queued || done(); });
+    idle--;
+  }
+
+  owner = previous;
+}
+
+void Scheduler::run() {
+  work(0, [this] { return !pending; });
+}
+
+std::vector<uint64_t> Scheduler::busy() const {
+  std::vector<uint64_t> times;
+
+  for (const auto &queue : queues)
+    times.push_back(queue->busy);
+
+  return times;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task scheduler
+//
+// Every worker owns a queue of tasks. It runs the last task of its own queue
+// first, and when it runs out of tasks, steals the oldest task of another
+// queue. A task submitted from a worker goes to the queue of that worker, so
+// work split by a task stays close to it until someone runs out of work.
+//
+// The thread calling `run` takes part as the first worker; the others are
+// threads started with the scheduler, that wait for tasks until it is
+// destroyed. A scheduler of size 1 runs everything on the calling thread.
+struct Scheduler {
+  using Task = std::function<void()>;
+
+  // Create a scheduler for `threads` workers, 0 meaning `concurrency()`
+  explicit Scheduler(size_t threads = 0);
+  ~Scheduler();
+
+  // The amount of threads to use by default
+  static size_t concurrency();
+
+  size_t size() const { return queues.size(); }
+
+  // Add a task to run. Tasks can be submitted from any thread, including from
+  // within another task.
+  void submit(Task &&);
+
+  // Whether workers are waiting for tasks, with none left in the queues: this
+  // is the time to split work further
+  bool starving() const { return idle && !queued; }
+
+  // Run tasks on the calling thread until all the submitted tasks are done
+  void run();
+
+  // The time every worker spent running tasks, in nanoseconds
+  std::vector<uint64_t> busy() const;
+
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<Task> tasks;
+    // Time spent by the worker running tasks
+    std::atomic<uint64_t> busy{0};
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  // Tasks waiting in the queues, tasks submitted and not finished yet, and
+  // workers waiting for tasks
+  std::atomic<size_t> queued, pending, idle;
+  // Queue receiving the next task submitted from outside the workers
+  std::atomic<size_t> next;
+
+  std::mutex lock;
+  std::condition_variable available;
+  bool stopping;
+
+  // Take a task, from the queue of `worker` or from another one
+  bool take(size_t worker, Task *);
+
+  // Run tasks as `worker` until `done` returns true
+  void work(size_t worker, const std::function<bool()> &done);
+};
@@ -5,10 +5,12 @@
 
 namespace mcmap {
 namespace versions {
-std::map<int, std::function<void(Section *, const nbt::NBT &)>> init = {
-    {3100, init_versions::v3100}, {2840, init_versions::v2840},
-    {2534, init_versions::v2534}, {1628, init_versions::v1628},
-    {0, init_versions::catchall},
+std::map<int, std::function<void(Section *, const nbt::View &,
+                                 const Colors::Index &)>>
+    init = {
+        {3100, init_versions::v3100}, {2840, init_versions::v2840},
+        {2534, init_versions::v2534}, {1628, init_versions::v1628},
+        {0, init_versions::catchall},
 };
 } // namespace versions
 } // namespace mcmap
@@ -29,25 +31,54 @@ Section::Section() : colors{&_void} {
   lights.fill(std::numeric_limits<light_array::value_type>::min());
 }
 
-void Section::loadPalette(const Colors::Palette &defined) {
-  // Pick the colors from the Palette
-  for (const auto &color : palette) {
-    const string namespacedId = color["Name"].get<string>();
-    auto query = defined.find(namespacedId);
-
-    if (query == defined.end()) {
-      logger::error("Color of block {} not found", namespacedId);
-      colors.push_back(&_void);
-    } else {
-      colors.push_back(&query->second);
-      if (namespacedId == "minecraft:beacon")
-        beaconIndex = colors.size() - 1;
-    }
+void Section::loadPalette(const nbt::View &entries,
+                          const Colors::Index &index) {
+  // Remove the air that is default-constructed
+  colors.clear();
+  colors.reserve(entries.size());
+  ids.reserve(entries.size());
+  states.reserve(entries.size());
+
+  for (const auto &entry : entries) {
+    // The name is hashed straight from the chunk data
+    const std::string_view name =
+        entry.contains("Name") ? entry["Name"].get<std::string_view>() : "";
+
+    // Only the properties used when drawing are kept from the entry, as the
+    // chunk data does not outlive the section
+    addEntry(name, BlockState(entry), index);
+  }
+}
+
+void Section::addEntry(std::string_view name, const BlockState &state,
+                       const Colors::Index &index) {
+  const Colors::Index::id_t id = index.find(name);
+
+  if (id == Colors::Index::unknown) {
+    logger::error("Color of block {} not found", name);
+    colors.push_back(&_void);
+  } else {
+    colors.push_back(index.block(id));
+    if (id == index.beacon)
+      beaconIndex = colors.size() - 1;
   }
+
+  ids.push_back(id);
+  states.push_back(state);
+}
+
+void Section::markOccluders() {
+  std::vector<bool> opaque(colors.size());
+  for (size_t i = 0; i < colors.size(); i++)
+    opaque[i] = colors[i]->occludes();
+
+  if (!opaque.empty())
+    for (size_t i = 0; i < blocks.size(); i++)
+      occluders[i] = opaque[blocks[i]];
 }
 
-Section::Section(const nbt::NBT &raw_section, const int dataVersion,
-                 const Coordinates chunk)
+Section::Section(const nbt::View &raw_section, const int dataVersion,
+                 const Colors::Index &index, const Coordinates chunk)
     : Section() {
 
   // Get data from the NBT
@@ -57,27 +88,27 @@ Section::Section(const nbt::NBT &raw_section, const int dataVersion,
   auto init_it = compatible(mcmap::versions::init, dataVersion);
 
   if (init_it != mcmap::versions::init.end()) {
-    init_it->second(this, raw_section);
+    init_it->second(this, raw_section, index);
   }
 
   // Iron out potential corruption errors
   for (block_array::reference index : blocks) {
-    if (index > palette.size() - 1) {
+    if (index > ids.size() - 1) {
       logger::trace("Malformed section: block is undefined in palette");
       index = 0;
     }
   }
 
+  markOccluders();
+
   // Import lighting data if present
   if (raw_section.contains("BlockLight")) {
-    const nbt::NBT::tag_byte_array_t *blockLights =
-        raw_section["BlockLight"].get<const nbt::NBT::tag_byte_array_t *>();
-
-    if (blockLights->size() == 2048) {
-      for (nbt::NBT::tag_byte_array_t::size_type i = 0; i < blockLights->size();
-           i++) {
-        lights[i] = blockLights->at(i);
-      }
-    }
+    const nbt::View::Array<int8_t> blockLights =
+        raw_section["BlockLight"].array<int8_t>();
+
+    // The nibbles are stored as is, they can be copied straight from the
+    // buffer
+    if (blockLights.size() == 2048)
+      memcpy(lights.data(), blockLights.data, lights.size());
   }
 }
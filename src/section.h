@@ -1,8 +1,11 @@
 #pragma once
 
+#include "./block_state.h"
 #include "./colors.h"
 #include <2DCoordinates.hpp>
+#include <bitset>
 #include <nbt/nbt.hpp>
+#include <nbt/view.hpp>
 
 struct Section {
   // Each block is encoded on 16 bits as an index in the palette - where only 12
@@ -13,6 +16,12 @@ struct Section {
   // in the following array
   using color_array = std::vector<const Colors::Block *>;
   using light_array = std::array<uint8_t, 2048>;
+  // One bit per block, set when the block hides what is drawn behind it
+  using occluder_array = std::bitset<4096>;
+
+  // The identifiers of the blocks of the palette, from the index used to load
+  // the section
+  using id_array = std::vector<Colors::Index::id_t>;
 
   // The vertical index of the section
   int8_t Y;
@@ -21,13 +30,17 @@ struct Section {
 
   block_array blocks;
   color_array colors;
+  id_array ids;
   light_array lights;
-  std::vector<nbt::NBT> palette;
+  occluder_array occluders;
+  // The drawing properties of the blocks of the palette
+  std::vector<BlockState> states;
 
   block_array::value_type beaconIndex;
 
   Section();
-  Section(const nbt::NBT &, const int, const Coordinates = {0, 0});
+  Section(const nbt::View &, const int, const Colors::Index &,
+          const Coordinates = {0, 0});
   Section(Section &&other) { *this = std::move(other); }
 
   Section &operator=(Section &&other) {
@@ -38,17 +51,17 @@ struct Section {
 
     blocks = std::move(other.blocks);
     lights = std::move(other.lights);
+    occluders = other.occluders;
     colors = std::move(other.colors);
-    palette = std::move(other.palette);
+    ids = std::move(other.ids);
+    states = std::move(other.states);
     return *this;
   }
 
   inline bool empty() const {
     // Check the state of the section by looking at its palette: a section with
     // only air does not need to be rendered
-    return palette.empty() ||
-           (palette.size() == 1 &&
-            palette[0]["Name"].get<std::string>() == "minecraft:air");
+    return ids.empty() || (ids.size() == 1 && ids[0] == Colors::Index::air);
   }
 
   inline block_array::value_type block_at(uint8_t x, uint8_t y,
@@ -68,9 +81,29 @@ struct Section {
     return (index % 2 ? lights[index / 2] >> 4 : lights[index / 2] & 0x0f);
   }
 
-  inline const nbt::NBT &state_at(uint8_t x, uint8_t y, uint8_t z) const {
-    return palette[blocks[x + 16 * z + 16 * 16 * y]];
+  inline bool occludes(uint8_t x, uint8_t y, uint8_t z) const {
+    return occluders[x + 16 * z + 16 * 16 * y];
+  }
+
+  inline Colors::Index::id_t id_at(uint8_t x, uint8_t y, uint8_t z) const {
+    // Sections without a palette have no identifiers
+    if (ids.empty())
+      return Colors::Index::unknown;
+
+    return ids[blocks[x + 16 * z + 16 * 16 * y]];
+  }
+
+  inline const BlockState &state_at(uint8_t x, uint8_t y, uint8_t z) const {
+    return states[blocks[x + 16 * z + 16 * 16 * y]];
   }
 
-  void loadPalette(const Colors::Palette &);
+  // Resolve the blocks of a palette from the chunk data
+  void loadPalette(const nbt::View &, const Colors::Index &);
+
+  // Append a block to the palette, resolved through the index
+  void addEntry(std::string_view, const BlockState &, const Colors::Index &);
+
+  // Record the blocks hiding the ones behind them, for the renderer to skip
+  // drawing what it would overwrite anyway
+  void markOccluders();
 };
@@ -5,6 +5,7 @@ void Settings::to_json(json &j, const Settings::WorldOptions &o) {
   j["mode"] = o.mode;
   j["output"] = o.outFile.string();
   j["colors"] = o.colorFile.string();
+  j["cache"] = o.chunkCache.string();
 
   j["save"] = o.save;
   j["dimension"] = o.dim;
@@ -19,4 +20,7 @@ void Settings::to_json(json &j, const Settings::WorldOptions &o) {
 
   j["memory"] = o.mem_limit;
   j["tile"] = o.tile_size;
+  j["zoom"] = o.zoom_levels;
+  j["incremental"] = o.incremental;
+  j["multiview"] = o.multiview;
 }
@@ -16,6 +16,10 @@ const string OUTPUT_DEFAULT = "output.png";
 const string OUTPUT_TILED_DEFAULT = "output";
 const size_t PADDING_DEFAULT = 5;
 const size_t TILE_SIZE_DEFAULT = 0;
+const uint8_t ZOOM_LEVELS_MAX = 16;
+const size_t FRAGMENT_SIZE_DEFAULT = 1024;
+// All the chunks of a fragment are kept when drawing it in every orientation
+const size_t MULTIVIEW_FRAGMENT_SIZE_DEFAULT = 256;
 
 enum Action { RENDER, DUMPCOLORS, HELP };
 
@@ -25,6 +29,8 @@ struct WorldOptions {
 
   // Files to use
   fs::path outFile, colorFile;
+  // Directory keeping the decoded chunks between runs, if not empty
+  fs::path chunkCache;
 
   // Map boundaries
   SaveFile save;
@@ -34,7 +40,13 @@ struct WorldOptions {
   // Image settings
   uint16_t padding;
   bool hideWater, hideBeacons, shading, lighting;
-  size_t tile_size; // 0 means no tiling
+  size_t tile_size;    // 0 means no tiling
+  uint8_t zoom_levels; // Zoomed out levels of tiles
+
+  // Only draw the fragments of the map that changed since the last render
+  bool incremental;
+  // Draw the map in the four orientations at once
+  bool multiview;
 
   // Marker storage
   uint8_t totalMarkers;
@@ -45,7 +57,8 @@ struct WorldOptions {
   size_t fragment_size;
 
   WorldOptions()
-      : mode(RENDER), outFile(OUTPUT_DEFAULT), colorFile(""), save(),
+      : mode(RENDER), outFile(OUTPUT_DEFAULT), colorFile(""), chunkCache(""),
+        save(),
         dim("overworld") {
 
     boundaries.setUndefined();
@@ -53,15 +66,17 @@ struct WorldOptions {
     boundaries.maxY = mcmap::constants::max_y;
 
     hideWater = hideBeacons = shading = lighting = false;
+    incremental = multiview = false;
     padding = PADDING_DEFAULT;
     tile_size = TILE_SIZE_DEFAULT;
+    zoom_levels = 0;
 
     totalMarkers = 0;
 
     // Default 3.5G of memory maximum
     mem_limit = 3500 * uint64_t(1024 * 1024);
     // Render whole regions at once
-    fragment_size = 1024;
+    fragment_size = FRAGMENT_SIZE_DEFAULT;
   }
 
   fs::path regionDir() const { return save.region(dim); }
@@ -0,0 +1,112 @@
+#include "./statistics.h"
+#include <fstream>
+#include <logger.hpp>
+
+#ifdef _WINDOWS
+#include <windows.h>
+// windows.h has to come first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Statistics {
+
+namespace {
+
+const std::array<const char *, STAGES> stage_names = {
+    "io",    "inflate", "parse",   "sections", "draw",
+    "wait",  "spill",   "compose", "encode",
+};
+
+const std::array<const char *, COUNTERS> counter_names = {
+    "bytesRead",       "bytesWritten",    "chunksDecoded",
+    "chunksCached",    "chunksSkipped",   "sectionsDecoded",
+    "sectionsSkipped", "fragmentsDrawn",  "fragmentsReused",
+    "fragmentsPacked", "spills",
+};
+
+double seconds(uint64_t nanoseconds) { return nanoseconds / 1e9; }
+
+} // namespace
+
+Report &current() {
+  static Report report;
+  return report;
+}
+
+void Report::reset() {
+  for (auto &stage : stages)
+    stage = 0;
+
+  for (auto &counter : counters)
+    counter = 0;
+
+  start = clock::now();
+  elapsed = drawing = peak_memory = 0;
+  busy.clear();
+}
+
+void Report::finish() {
+  elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                                 start)
+                .count();
+  peak_memory = Statistics::peak_memory();
+}
+
+json Report::to_json() const {
+  json data({{"elapsed", seconds(elapsed)}, {"peakMemory", peak_memory}});
+
+  for (uint8_t i = 0; i < STAGES; i++)
+    data["stages"][stage_names[i]] = seconds(stages[i]);
+
+  for (uint8_t i = 0; i < COUNTERS; i++)
+    data["counters"][counter_names[i]] = uint64_t(counters[i]);
+
+  // The share of the drawing every worker spent running tasks
+  data["threads"] = json::array();
+
+  for (uint64_t time : busy)
+    data["threads"].push_back(
+        {{"busy", seconds(time)},
+         {"utilization", drawing ? double(time) / drawing : 0.0}});
+
+  return data;
+}
+
+bool Report::save(const std::filesystem::path &file) const {
+  std::ofstream output(file);
+
+  if (!output) {
+    logger::error("Failed to open {} for writing", file.string());
+    return false;
+  }
+
+  output << to_json().dump(2);
+  return bool(output);
+}
+
+uint64_t peak_memory() {
+#ifdef _WINDOWS
+  PROCESS_MEMORY_COUNTERS usage;
+
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &usage, sizeof(usage)))
+    return 0;
+
+  return usage.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  // Kilobytes on Linux
+  return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+} // namespace Statistics
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <json.hpp>
+#include <vector>
+
+using nlohmann::json;
+
+// Instrumentation of a render
+//
+// The time spent in every stage of a render is measured, and what goes through
+// them counted, in a report written alongside the output. The timers and
+// counters are relaxed atomic additions, made once per chunk, fragment or line
+// at most: they are cheap enough to always be on.
+//
+// Stage times are summed over the threads spending them. A stage timed within
+// another on the same thread is only counted in its own stage: the time spent
+// loading chunks while drawing is not counted as drawing.
+namespace Statistics {
+
+enum Stage : uint8_t {
+  IO = 0,   // Reading region headers, cached chunks and packed fragments
+  INFLATE,  // Decompressing chunks
+  PARSE,    // Indexing the NBT data of chunks
+  SECTIONS, // Building sections from the NBT data
+  DRAW,     // Drawing fragments
+  WAIT,     // Waiting for chunks decoded by other workers
+  SPILL,    // Packing fragments and writing them to disk
+  COMPOSE,  // Composing the lines of the final image
+  ENCODE,   // Compressing and writing the images
+  STAGES,
+};
+
+enum Counter : uint8_t {
+  BYTES_READ = 0,
+  BYTES_WRITTEN,
+  CHUNKS_DECODED,   // Decoded from the region files
+  CHUNKS_CACHED,    // Read back from the chunk cache
+  CHUNKS_SKIPPED,   // Missing, empty or in an unsupported format
+  SECTIONS_DECODED, // Holding blocks to draw
+  SECTIONS_SKIPPED, // Holding only air
+  FRAGMENTS_DRAWN,
+  FRAGMENTS_REUSED, // Read back from a previous render
+  FRAGMENTS_PACKED,
+  SPILLS, // Packed fragments written to disk to save memory
+  COUNTERS,
+};
+
+struct Report {
+  using clock = std::chrono::steady_clock;
+
+  // Time spent in every stage, in nanoseconds
+  std::array<std::atomic<uint64_t>, STAGES> stages;
+  std::array<std::atomic<uint64_t>, COUNTERS> counters;
+
+  clock::time_point start;
+  // Duration of the render, in nanoseconds
+  uint64_t elapsed;
+
+  // Time spent running tasks by every worker drawing fragments, and duration
+  // of the drawing, in nanoseconds
+  std::vector<uint64_t> busy;
+  uint64_t drawing;
+
+  // Peak resident memory of the process, in bytes
+  uint64_t peak_memory;
+
+  Report() { reset(); }
+
+  // Start a new report
+  void reset();
+
+  // Record the duration of the render and the memory it used
+  void finish();
+
+  json to_json() const;
+  bool save(const std::filesystem::path &) const;
+};
+
+// Receives the report at the end of a render
+using Callback = std::function<void(const Report &)>;
+
+// The report of the render in progress
+Report &current();
+
+inline void count(Counter counter, uint64_t amount = 1) {
+  current().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+// Time a stage, from construction to destruction
+struct Timer {
+  explicit Timer(Stage stage)
+      : stage(stage), begin(Report::clock::now()), before(nested()) {}
+
+  Timer(const Timer &) = delete;
+  Timer &operator=(const Timer &) = delete;
+
+  ~Timer() {
+    const uint64_t elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Report::clock::now() - begin)
+            .count();
+
+    // The time of the timers nested in this one was counted by them
+    current().stages[stage].fetch_add(elapsed - (nested() - before),
+                                      std::memory_order_relaxed);
+    nested() = before + elapsed;
+  }
+
+private:
+  const Stage stage;
+  const Report::clock::time_point begin;
+  const uint64_t before;
+
+  // Time counted by the timers of the current thread
+  static uint64_t &nested() {
+    thread_local uint64_t counted = 0;
+    return counted;
+  }
+};
+
+// The peak resident memory of the process, in bytes, or 0 if unknown
+uint64_t peak_memory();
+
+} // namespace Statistics
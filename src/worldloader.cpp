@@ -1,137 +1,381 @@
 #include "./worldloader.h"
+#include "./compression.h"
+#include "./statistics.h"
 #include <nbt/parser.hpp>
 #include <translator.hpp>
-#include <zlib.h>
 
 namespace Terrain {
 
 Data::Chunk empty_chunk;
 
-bool decompressChunk(const uint32_t offset, FILE *regionHandle,
-                     uint8_t *chunkBuffer, uint64_t *length,
-                     const std::filesystem::path &filename) {
-  uint8_t zData[COMPRESSED_BUFFER];
+ChunkStore::ChunkStore(const World::Coordinates &map, bool whole)
+    : whole(whole) {
+  // The renderer goes along x in its outer loop when oriented north-west or
+  // south-east, and along z otherwise
+  shared_x = map.orientation == Map::NW || map.orientation == Map::SE;
 
-  if (0 != FSEEK(regionHandle, offset, SEEK_SET)) {
-    logger::debug("Accessing chunk data in file {} failed: {}",
-                  filename.string(), strerror(errno));
-    return false;
-  }
+  const int32_t start = shared_x ? map.minZ : map.minX,
+                end = shared_x ? map.maxZ : map.maxX;
 
-  // Read the 5 bytes that give the size and type of data
-  if (5 != fread(zData, sizeof(uint8_t), 5, regionHandle)) {
-    logger::debug("Reading chunk size from region file {} failed: {}",
-                  filename.string(), strerror(errno));
-    return false;
-  }
+  origin = start - 1;
+  length = end - start + 3;
 
-  // Read the size on the first 4 bytes, discard the type
-  *length = translate<uint32_t>(zData);
-  (*length)--; // Sometimes the data is 1 byte smaller
+  // When keeping every row, the rows before and after the fragment are kept
+  // as well
+  const int32_t rows =
+      whole ? (shared_x ? map.maxX - map.minX : map.maxZ - map.minZ) + 3 : 2;
 
-  if (fread(zData, sizeof(uint8_t), *length, regionHandle) != *length) {
-    logger::debug("Not enough data for chunk: {}", strerror(errno));
-    return false;
-  }
+  first = (shared_x ? map.minX : map.minZ) - 1;
+
+  slots.resize(rows * length);
+}
+
+ChunkStore::Chunk *ChunkStore::slot(const ChunkCoordinates coords) {
+  const int32_t row = shared_x ? coords.x : coords.z;
+  const int32_t along = (shared_x ? coords.z : coords.x) - origin;
+
+  if (along < 0 || size_t(along) >= length)
+    return nullptr;
+
+  if (!whole)
+    return &slots[(row & 1) * length + along];
+
+  if (row < first || size_t(row - first) >= slots.size() / length)
+    return nullptr;
+
+  return &slots[(row - first) * length + along];
+}
 
-  z_stream zlibStream;
-  memset(&zlibStream, 0, sizeof(z_stream));
-  zlibStream.next_in = (Bytef *)zData;
-  zlibStream.next_out = (Bytef *)chunkBuffer;
-  zlibStream.avail_in = *length;
-  zlibStream.avail_out = DECOMPRESSED_BUFFER;
-  inflateInit2(&zlibStream, 32 + MAX_WBITS);
+ChunkStore::Chunk *ChunkStore::find(const ChunkCoordinates coords) {
+  Chunk *stored = slot(coords);
 
-  int status = inflate(&zlibStream, Z_FINISH); // decompress in one step
-  inflateEnd(&zlibStream);
+  if (!stored || !stored->valid() || stored->position != coords)
+    return nullptr;
 
-  if (status != Z_STREAM_END) {
-    logger::debug("Decompressing chunk data failed: {}", zError(status));
+  return stored;
+}
+
+const ChunkStore::Chunk *ChunkStore::find(const ChunkCoordinates coords) const {
+  return const_cast<ChunkStore *>(this)->find(coords);
+}
+
+void ChunkStore::insert(Chunk &&chunk) {
+  Chunk *stored = slot(chunk.position);
+
+  if (stored)
+    *stored = std::move(chunk);
+}
+
+void ChunkStore::erase(const ChunkCoordinates coords) {
+  if (whole)
+    return;
+
+  Chunk *stored = find(coords);
+
+  if (stored)
+    *stored = Chunk();
+}
+
+bool decompressChunk(const ChunkData &compressed,
+                     std::vector<uint8_t> &chunkBuffer, uint64_t *length) {
+  size_t size;
+
+  if (!Compression::decompress(compressed.compression, compressed.data,
+                               compressed.size, chunkBuffer, &size))
     return false;
-  }
 
-  *length = zlibStream.total_out;
+  *length = size;
   return true;
 }
 
-void Data::loadChunk(const ChunkCoordinates coords) {
-  FILE *regionHandle;
-  uint8_t regionHeader[REGION_HEADER_SIZE], chunkBuffer[DECOMPRESSED_BUFFER];
-  int32_t regionX = REGION(coords.x), regionZ = REGION(coords.z),
-          cX = coords.x & 0x1f, cZ = coords.z & 0x1f;
-  uint64_t length;
+const Region &Data::regionAt(const Coordinates coords) {
+  auto query = regions.find(coords);
+
+  if (query != regions.end())
+    return query->second;
 
   std::filesystem::path regionFile = std::filesystem::path(regionDir) /=
-      fmt::format("r.{}.{}.mca", regionX, regionZ);
+      fmt::format("r.{}.{}.mca", coords.x, coords.z);
+
+  // An invalid region is stored as well, to avoid looking for a missing file
+  // for every chunk it should contain
+  Statistics::Timer timer(Statistics::IO);
+  Region region(regionFile);
 
-  if (!std::filesystem::exists(regionFile)) {
+  if (region.valid())
+    Statistics::count(Statistics::BYTES_READ,
+                      sizeof(region.locations) + sizeof(region.timestamps));
+  else
     logger::trace("Region file r.{}.{}.mca does not exist, skipping ..",
-                  regionX, regionZ);
-    return;
+                  coords.x, coords.z);
+
+  return regions.emplace(coords, std::move(region)).first->second;
+}
+
+Data::Chunk decodeChunk(const Region &region,
+                        const Data::ChunkCoordinates coords,
+                        const Colors::Index &palette,
+                        std::vector<uint8_t> &chunkBuffer,
+                        const ChunkCache *cache) {
+  uint64_t length;
+
+  const uint16_t index = ((coords.z & 0x1f) << 5) + (coords.x & 0x1f);
+  const ChunkData compressed = region.chunk(index);
+
+  if (compressed.empty()) {
+    Statistics::count(Statistics::CHUNKS_SKIPPED);
+    return Data::Chunk();
   }
 
-  if (!(regionHandle = fopen(regionFile.string().c_str(), "rb"))) {
-    logger::error("Opening region file `{}` failed: {}", regionFile.string(),
-                  strerror(errno));
-    return;
+  ChunkCache::Key key = {0, 0, 0};
+
+  if (cache) {
+    Statistics::Timer timer(Statistics::IO);
+
+    key = ChunkCache::key(region, index);
+    Data::Chunk cached = cache->load(coords, key, palette);
+
+    if (cached.valid()) {
+      Statistics::count(Statistics::CHUNKS_CACHED);
+      return cached;
+    }
   }
 
-  // Then, we read the header (of size 4K) storing the chunks locations
-  if (fread(regionHeader, sizeof(uint8_t), REGION_HEADER_SIZE, regionHandle) !=
-      REGION_HEADER_SIZE) {
-    logger::error("Region header too short in `{}`", regionFile.string());
-    fclose(regionHandle);
-    return;
+  Statistics::count(Statistics::BYTES_READ, compressed.size);
+
+  // The chunk is created from views on the decompressed data; nothing is
+  // copied until the sections are built
+  nbt::View data;
+  bool decoded;
+
+  {
+    Statistics::Timer timer(Statistics::INFLATE);
+    decoded = decompressChunk(compressed, chunkBuffer, &length);
   }
 
-  const uint32_t offset =
-      (translate<uint32_t>(regionHeader + ((cZ << 5) + cX) * 4) >> 8) * 4096;
+  if (decoded) {
+    Statistics::Timer timer(Statistics::PARSE);
+    decoded = nbt::index(chunkBuffer.data(), length, data,
+                         &Data::Chunk::fields) &&
+              Data::Chunk::assert_chunk(data);
+  }
 
-  if (!offset || !decompressChunk(offset, regionHandle, chunkBuffer, &length,
-                                  regionFile)) {
-    fclose(regionHandle);
-    return;
+  if (!decoded) {
+    Statistics::count(Statistics::CHUNKS_SKIPPED);
+    return Data::Chunk();
   }
 
-  nbt::NBT data;
+  Data::Chunk chunk(data, palette, coords);
+
+  Statistics::count(chunk.valid() ? Statistics::CHUNKS_DECODED
+                                  : Statistics::CHUNKS_SKIPPED);
+
+  if (cache && chunk.valid()) {
+    Statistics::Timer timer(Statistics::IO);
+    cache->store(chunk, key, palette);
+  }
+
+  return chunk;
+}
+
+Data::~Data() {
+  if (pipeline)
+    pipeline->stop();
+}
 
-  if (!nbt::parse(chunkBuffer, length, data) || !Chunk::assert_chunk(data)) {
-    fclose(regionHandle);
+void Data::loadChunk(const ChunkCoordinates coords) {
+  const Region &region = regionAt({REGION(coords.x), REGION(coords.z)});
+
+  if (!region.valid())
+    return;
+
+  Chunk chunk = decodeChunk(region, coords, palette, buffer, cache);
+
+  if (chunk.valid())
+    chunks.insert(std::move(chunk));
+}
+
+void Data::schedule(const std::vector<ChunkCoordinates> &order) {
+  // Without other workers to help, chunks are decoded on demand
+  if (!scheduler || scheduler->size() < 2 || pipeline)
     return;
+
+  std::vector<DecodeQueue::Job> jobs;
+
+  for (const auto &coords : order) {
+    // Only the first access to a chunk is scheduled
+    if (scheduled.find(coords) != scheduled.end())
+      continue;
+
+    // Open the region files from this thread, the decoders only get read
+    // access to them
+    const Region &region = regionAt({REGION(coords.x), REGION(coords.z)});
+
+    if (!region.valid())
+      continue;
+
+    scheduled.emplace(coords, jobs.size());
+    jobs.push_back({coords, &region});
   }
 
-  fclose(regionHandle);
+  if (jobs.empty())
+    return;
+
+  // The chunks are accessed one row after the other, the chunks of a row
+  // sharing their x coordinate when oriented north-west or south-east
+  const bool shared_x =
+      map.orientation == Map::NW || map.orientation == Map::SE;
+  const size_t rows =
+      shared_x ? map.maxX - map.minX + 1 : map.maxZ - map.minZ + 1;
+  const size_t row = (jobs.size() + rows - 1) / rows;
 
-  chunks[coords] = Chunk(data, palette, coords);
+  pipeline =
+      std::make_shared<DecodeQueue>(std::move(jobs), palette, row, cache);
+}
+
+bool Data::fetchChunk(const ChunkCoordinates coords) {
+  auto query = scheduled.find(coords);
+
+  // If the chunk was not scheduled or was already delivered, it will not come
+  // out of the pipeline
+  if (!pipeline || query == scheduled.end() ||
+      query->second < pipeline->consumed)
+    return false;
+
+  while (!pipeline->done() && pipeline->consumed <= query->second) {
+    // Workers running out of work decode the next row of chunks
+    if (scheduler->starving() && pipeline->waiting()) {
+      std::shared_ptr<DecodeQueue> queue = pipeline;
+      scheduler->submit([queue] { queue->decode(queue->row); });
+    }
+
+    ChunkCoordinates position;
+    Chunk chunk = pipeline->pop(&position);
+
+    if (chunk.valid())
+      chunks.insert(std::move(chunk));
+  }
+
+  return true;
 }
 
 const Data::Chunk &Data::chunkAt(const ChunkCoordinates coords,
                                  const Map::Orientation o, bool surround) {
-  if (chunks.find(coords) == chunks.end())
+  if (!chunks.find(coords) && !fetchChunk(coords))
     loadChunk(coords);
 
   if (surround) {
     ChunkCoordinates left = coords + left_in(o);
     ChunkCoordinates right = coords + right_in(o);
 
-    if (chunks.find(left) == chunks.end())
+    if (!chunks.find(left) && !fetchChunk(left))
       loadChunk(left);
-    if (chunks.find(right) == chunks.end())
+    if (!chunks.find(right) && !fetchChunk(right))
       loadChunk(right);
   }
 
-  auto query = chunks.find(coords);
-  if (query == chunks.end())
+  const Chunk *chunk = chunks.find(coords);
+  if (!chunk)
     return empty_chunk;
 
-  return query->second;
+  return *chunk;
+}
+
+void Data::free_chunk(const ChunkCoordinates coords) { chunks.erase(coords); }
+
+DecodeQueue::DecodeQueue(std::vector<Job> &&_jobs,
+                         const Colors::Index &palette, size_t row,
+                         const ChunkCache *cache)
+    : palette(palette), cache(cache), jobs(std::move(_jobs)), row(row),
+      claimed(0), consumed(0), active(0), stopping(false) {
+  // Let the helpers get two rows ahead of the renderer at most, to keep the
+  // memory usage in check
+  slots.resize(std::min(jobs.size(), 2 * row));
+}
+
+bool DecodeQueue::waiting() {
+  std::lock_guard<std::mutex> guard(lock);
+
+  return !stopping && claimed < jobs.size() &&
+         claimed < consumed + slots.size();
+}
+
+void DecodeQueue::decode(size_t count) {
+  // The buffer of every helper grows to fit the largest chunk it decoded, and
+  // is kept from one row to the next
+  thread_local std::vector<uint8_t> chunkBuffer;
+
+  for (size_t i = 0; i < count; i++) {
+    size_t index;
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+
+      if (stopping || claimed == jobs.size() ||
+          claimed >= consumed + slots.size())
+        return;
+
+      index = claimed++;
+      active++;
+    }
+
+    Chunk chunk = decodeChunk(*jobs[index].region, jobs[index].position,
+                              palette, chunkBuffer, cache);
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      Slot &slot = slots[index % slots.size()];
+
+      slot.chunk = std::move(chunk);
+      slot.index = index;
+      slot.ready = true;
+      active--;
+    }
+
+    produced.notify_all();
+  }
+}
+
+DecodeQueue::Chunk DecodeQueue::pop(ChunkCoordinates *position) {
+  std::unique_lock<std::mutex> guard(lock);
+  const size_t index = consumed;
+
+  *position = jobs[index].position;
+
+  // If no helper picked the chunk up, it is decoded right here
+  if (claimed == index) {
+    claimed++;
+    guard.unlock();
+
+    Chunk chunk = decodeChunk(*jobs[index].region, jobs[index].position,
+                              palette, buffer, cache);
+
+    guard.lock();
+    consumed++;
+
+    return chunk;
+  }
+
+  Slot &slot = slots[index % slots.size()];
+
+  {
+    Statistics::Timer timer(Statistics::WAIT);
+    produced.wait(guard,
+                  [&slot, index] { return slot.ready && slot.index == index; });
+  }
+
+  Chunk chunk = std::move(slot.chunk);
+  slot.ready = false;
+  consumed++;
+
+  return chunk;
 }
 
-void Data::free_chunk(const ChunkCoordinates coords) {
-  auto query = chunks.find(coords);
+void DecodeQueue::stop() {
+  std::unique_lock<std::mutex> guard(lock);
 
-  if (query != chunks.end())
-    chunks.erase(query);
+  stopping = true;
+  produced.wait(guard, [this] { return !active; });
 }
 
 } // namespace Terrain
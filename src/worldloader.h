@@ -2,42 +2,204 @@
 #define WORLDLOADER_H_
 
 #include "./chunk.h"
+#include "./chunk_cache.h"
 #include "./helper.h"
+#include "./region.h"
+#include "./scheduler.h"
+#include <condition_variable>
 #include <filesystem>
 #include <map.hpp>
+#include <memory>
+#include <mutex>
 #include <nbt/nbt.hpp>
 
 namespace Terrain {
 
+// Decoding pipeline
+// Chunks read, inflated and parsed ahead of the renderer. The chunks to decode
+// are given as an ordered list, and are delivered in that same order through
+// a bounded window of slots. The workers of the scheduler left without work
+// help by decoding the next chunks a row at a time, and stop when they get too
+// far ahead of the consumer; the consumer waits for the next chunk in line if
+// it is being decoded, and decodes it itself if nobody picked it up.
+struct DecodeQueue {
+  using Chunk = mcmap::Chunk;
+  using ChunkCoordinates = mcmap::Chunk::coordinates;
+
+  struct Job {
+    ChunkCoordinates position;
+    const Region *region;
+  };
+
+  struct Slot {
+    size_t index;
+    bool ready;
+    Chunk chunk;
+
+    Slot() : index(0), ready(false) {}
+  };
+
+  const Colors::Index &palette;
+  const ChunkCache *cache;
+
+  std::vector<Job> jobs;
+  std::vector<Slot> slots;
+
+  // Amount of jobs decoded by a helper, about a row of chunks
+  size_t row;
+
+  // Index of the next job to claim, and of the next job to deliver
+  size_t claimed, consumed;
+  // Jobs being decoded by helpers
+  size_t active;
+  bool stopping;
+
+  std::mutex lock;
+  std::condition_variable produced;
+
+  // Decompression buffer of the consumer
+  std::vector<uint8_t> buffer;
+
+  // Decode `jobs` with rows of `row` jobs, the window holding two rows
+  DecodeQueue(std::vector<Job> &&jobs, const Colors::Index &, size_t row,
+              const ChunkCache * = nullptr);
+
+  bool done() const { return consumed == jobs.size(); }
+
+  // Whether there are chunks left to decode in the window
+  bool waiting();
+
+  // Block until the next chunk in line is decoded and return it
+  Chunk pop(ChunkCoordinates *);
+
+  // Decode up to `count` of the next chunks, as long as they fit in the window
+  void decode(size_t count);
+
+  // Stop decoding and wait for the helpers to finish their chunk, before the
+  // regions are closed
+  void stop();
+};
+
+// Chunk storage
+// The renderer draws the chunks of a fragment one row after the other, the
+// rows going along the x or z axis depending on the orientation. It only looks
+// at the row being drawn, and at the next one for lighting. The store holds
+// those two rows, with a chunk of margin on both ends for the neighbours of
+// the fragment: a chunk is addressed directly from its coordinates relative to
+// the fragment, and storing a chunk of a row frees the one left in its place
+// by the row before last.
+//
+// A store can also hold all the rows of the fragment at once, for it to be
+// drawn again in another orientation without decoding its chunks twice. Chunks
+// are then never freed.
+struct ChunkStore {
+  using Chunk = mcmap::Chunk;
+  using ChunkCoordinates = mcmap::Chunk::coordinates;
+
+  ChunkStore()
+      : shared_x(true), whole(false), origin(0), first(0), length(0) {}
+  // Create a store for the chunks of `map`, in chunk coordinates, keeping all
+  // of them if `whole` is set
+  explicit ChunkStore(const World::Coordinates &map, bool whole = false);
+
+  // Get a stored chunk, or nullptr if it is not in the store
+  Chunk *find(const ChunkCoordinates);
+  const Chunk *find(const ChunkCoordinates) const;
+
+  // Store a chunk at its position, if it falls in the fragment
+  void insert(Chunk &&);
+
+  // Free the chunk at the given position, if stored
+  void erase(const ChunkCoordinates);
+
+private:
+  // Whether the chunks of a row share their x coordinate
+  bool shared_x;
+
+  // Whether all the rows are kept
+  bool whole;
+
+  // The coordinate of the first chunk of a row, the coordinate of the first
+  // row, and the length of a row
+  int32_t origin, first;
+  size_t length;
+
+  // The rows, one after the other
+  std::vector<Chunk> slots;
+
+  // Slot for a position, or nullptr if it is outside of the fragment
+  Chunk *slot(const ChunkCoordinates);
+};
+
 struct Data {
   using Chunk = mcmap::Chunk;
   using ChunkCoordinates = mcmap::Chunk::coordinates;
-  using ChunkStore = std::map<ChunkCoordinates, Chunk>;
+  using RegionStore = std::map<Coordinates, Region>;
 
   // The coordinates of the loaded chunks. This coordinates maps
   // the CHUNKS loaded, not the blocks
   World::Coordinates map;
 
-  // The loaded chunks, organized as a map of coordinatesxchunk
+  // The loaded chunks, addressed by their coordinates
   ChunkStore chunks;
 
   fs::path regionDir;
-  const Colors::Palette &palette;
+  const Colors::Index &palette;
+
+  // The region files opened while loading chunks, indexed by region
+  // coordinates. Each file is mapped and its header parsed once for the
+  // lifetime of the fragment.
+  RegionStore regions;
 
-  // Default constructor
+  // Scheduler whose idle workers decode chunks ahead of the renderer. If
+  // null, the chunks are loaded on demand by the rendering thread.
+  Scheduler *scheduler;
+
+  // Decoded chunks saved by previous runs, if any
+  const ChunkCache *cache;
+
+  // The decoding pipeline, set up by `schedule`. It is shared with the tasks
+  // decoding chunks, that can outlive the data.
+  std::shared_ptr<DecodeQueue> pipeline;
+
+  // Chunks scheduled for decoding, and the position of each in the pipeline
+  std::map<ChunkCoordinates, size_t> scheduled;
+
+  // Decompression buffer for the chunks loaded on demand
+  std::vector<uint8_t> buffer;
+
+  // Default constructor. If `keep` is set, the chunks stay loaded until the
+  // data is destroyed, to draw the fragment more than once.
   explicit Data(const World::Coordinates &coords,
-                const std::filesystem::path &dir, const Colors::Palette &p)
-      : regionDir(dir), palette(p) {
+                const std::filesystem::path &dir, const Colors::Index &p,
+                Scheduler *scheduler = nullptr,
+                const ChunkCache *cache = nullptr, bool keep = false)
+      : regionDir(dir), palette(p), scheduler(scheduler), cache(cache) {
     map.minX = CHUNK(coords.minX);
     map.minZ = CHUNK(coords.minZ);
     map.maxX = CHUNK(coords.maxX);
     map.maxZ = CHUNK(coords.maxZ);
+    map.orientation = coords.orientation;
+
+    chunks = ChunkStore(map, keep);
   }
 
+  ~Data();
+
   // Chunk pre-processing methods
   void stripChunk(std::vector<nbt::NBT> *);
   void inflateChunk(std::vector<nbt::NBT> *);
 
+  // Access a region file, opening it if necessary
+  const Region &regionAt(const Coordinates);
+
+  // Give the order in which chunks will be accessed, to start decoding them
+  // ahead of time if a scheduler is available
+  void schedule(const std::vector<ChunkCoordinates> &);
+
+  // Get the chunks from the pipeline until the requested one is reached
+  bool fetchChunk(const ChunkCoordinates);
+
   // Chunk loading - should never be used, called by chunkAt in case of chunk
   // fault
   void loadChunk(const ChunkCoordinates);
@@ -49,6 +211,11 @@ struct Data {
   void free_chunk(const ChunkCoordinates);
 };
 
+// Decompress the data of a chunk into `chunkBuffer`, growing it as needed, and
+// set `length` to the size of the result
+bool decompressChunk(const ChunkData &, std::vector<uint8_t> &chunkBuffer,
+                     uint64_t *length);
+
 } // namespace Terrain
 
 #endif // WORLDLOADER_H_
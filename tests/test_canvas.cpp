@@ -1,3 +1,4 @@
+#include "../src/block_drawers.h"
 #include "../src/canvas.h"
 #include <gtest/gtest.h>
 
@@ -7,9 +8,9 @@ TEST(TestCanvas, TestCreateDefault) {
   ASSERT_TRUE(c1.type == Canvas::EMPTY);
   ASSERT_TRUE(c1.width() == c1.height() && c1.width() == 0);
 
-  c1 = Canvas(Canvas::BYTES);
+  c1 = Canvas(Canvas::SPARSE);
 
-  ASSERT_TRUE(c1.type == Canvas::BYTES);
+  ASSERT_TRUE(c1.type == Canvas::SPARSE);
   ASSERT_TRUE(c1.width() == c1.height() && c1.width() == 0);
 
   c1 = Canvas(Canvas::CANVAS);
@@ -24,9 +25,239 @@ TEST(TestCanvas, TestGetLine) {
 
   ASSERT_FALSE(c1.getLine(&buffer[0], 1000, 0));
 
-  c1 = Canvas(Canvas::BYTES);
+  c1 = Canvas(Canvas::SPARSE);
   ASSERT_FALSE(c1.getLine(&buffer[0], 1000, 0));
 
   c1 = Canvas(Canvas::CANVAS);
   ASSERT_FALSE(c1.getLine(&buffer[0], 1000, 0));
 }
+
+TEST(TestCanvas, TestDownsample) {
+  const uint8_t source[2 * 4 * 4] = {
+      // Top line
+      10, 20, 30, 255, 30, 40, 50, 255, 0, 0, 0, 0, 200, 100, 50, 255,
+      // Bottom line
+      10, 20, 30, 255, 30, 40, 50, 255, 0, 0, 0, 0, 0, 0, 0, 0};
+  uint8_t destination[2 * 4];
+
+  downsample(source, 4, destination);
+
+  const uint8_t expected[2 * 4] = {20, 30, 40, 255, 200, 100, 50, 64};
+  for (uint8_t i = 0; i < 2 * 4; i++)
+    ASSERT_EQ(destination[i], expected[i]);
+}
+
+TEST(TestCanvas, TestTileLevels) {
+  const fs::path output = fs::temp_directory_path() / "pyramid";
+  const uint8_t color[4] = {10, 20, 30, 255};
+
+  // A 32x18 canvas, tiled in 4x3 tiles of 8 pixels
+  Canvas canvas(Canvas::SPARSE);
+  canvas.map = World::Coordinates(0, 0, 0, 7, 0, 7);
+  canvas.drawing.sparse_buffer->resize(canvas.width(), canvas.height());
+  for (size_t y = 0; y < canvas.height(); y++)
+    for (size_t x = 0; x < canvas.width(); x++)
+      memcpy(canvas.drawing.sparse_buffer->write(x, y), color, 4);
+
+  ASSERT_TRUE(canvas.tile(output, 8, 2));
+
+  const std::array<std::pair<size_t, size_t>, 3> tiles = {
+      {{4, 3}, {2, 2}, {1, 1}}};
+
+  for (uint8_t z = 0; z < tiles.size(); z++)
+    for (size_t x = 0; x < tiles[z].first; x++)
+      for (size_t y = 0; y < tiles[z].second; y++)
+        ASSERT_TRUE(fs::exists(output / std::to_string(z) /
+                               std::to_string(x) / fmt::format("{}.png", y)));
+
+  ASSERT_FALSE(fs::exists(output / "3"));
+
+  // The top level covers the whole canvas in its 4 first lines
+  PNG::PNGReader top(output / "2" / "0" / "0.png");
+  std::vector<uint8_t> line(8 * 4);
+
+  ASSERT_EQ(top.get_width(), 8);
+  ASSERT_EQ(top.get_height(), 8);
+
+  for (uint8_t y = 0; y < 8; y++) {
+    top.getLine(line.data(), line.size());
+
+    for (uint8_t x = 0; x < 8; x++) {
+      if (y < 4) {
+        ASSERT_EQ(memcmp(&line[x * 4], color, 4), 0);
+      } else if (y > 4) {
+        ASSERT_EQ(line[x * 4 + 3], 0);
+      }
+    }
+  }
+
+  fs::remove_all(output);
+}
+
+TEST(TestCanvas, TestSparse) {
+  const uint8_t color[4] = {10, 20, 30, 255};
+
+  // A 32x18 canvas, in 1x1 block
+  Canvas canvas(Canvas::SPARSE);
+  canvas.map = World::Coordinates(0, 0, 0, 7, 0, 7);
+  canvas.drawing.sparse_buffer->resize(canvas.width(), canvas.height() + 1);
+
+  std::vector<uint8_t> line(canvas.width() * 4, 0);
+
+  ASSERT_EQ(canvas.drawing.sparse_buffer->allocated(), 0);
+  ASSERT_EQ(canvas.getLine(line.data(), line.size(), 3), canvas.width());
+  for (size_t x = 0; x < canvas.width(); x++)
+    ASSERT_EQ(line[x * 4 + 3], 0);
+
+  memcpy(canvas.drawing.sparse_buffer->write(5, 3), color, 4);
+
+  ASSERT_EQ(canvas.drawing.sparse_buffer->allocated(), 1);
+  canvas.getLine(line.data(), line.size(), 3);
+  ASSERT_EQ(memcmp(&line[5 * 4], color, 4), 0);
+  ASSERT_EQ(line[4 * 4 + 3], 0);
+}
+
+TEST(TestCanvas, TestSparseBlocks) {
+  SparseBuffer buffer;
+  buffer.resize(100, 70);
+
+  ASSERT_EQ(buffer.columns, 2);
+  ASSERT_EQ(buffer.rows, 2);
+
+  // Only the block written to is allocated
+  buffer.write(99, 69)[3] = 0xff;
+
+  ASSERT_EQ(buffer.allocated(), 1);
+  ASSERT_EQ(buffer.pixel(0, 69), nullptr);
+  ASSERT_EQ(buffer.pixel(64, 0), nullptr);
+  ASSERT_NE(buffer.pixel(64, 69), nullptr);
+  ASSERT_EQ(buffer.pixel(64, 69)[35 * 4 + 3], 0xff);
+  ASSERT_EQ(buffer.pixel(100, 69), nullptr);
+
+  // Looking pixels up allocates nothing
+  ASSERT_EQ(buffer.allocated(), 1);
+}
+
+TEST(TestCanvas, TestSparseDrawers) {
+  IsometricCanvas canvas;
+  canvas.setMap(World::Coordinates(0, 0, 0, 63, 0, 63));
+
+  const Colors::Block block(Colors::BlockTypes::FULL, "#102030");
+  const SparseBuffer &buffer = *canvas.drawing.sparse_buffer;
+
+  // A sprite ending on the last line of a block leaves the block below alone
+  drawFull(&canvas, 0, 60, BlockState(), &block);
+  ASSERT_EQ(buffer.allocated(), 1);
+  ASSERT_EQ(buffer.pixel(0, 64), nullptr);
+
+  ASSERT_EQ(memcmp(buffer.pixel(0, 60), &block.primary, 4), 0);
+  ASSERT_EQ(memcmp(buffer.pixel(3, 63), &block.light, 4), 0);
+}
+
+TEST(TestCanvas, TestCompositeLines) {
+  // A 3x3 grid of fragments, each of its own translucent color, and an empty
+  // fragment
+  std::vector<Canvas> fragments;
+
+  for (int32_t i = 0; i < 9; i++) {
+    Canvas fragment(Canvas::SPARSE);
+    fragment.map = World::Coordinates((i % 3) * 8, 0, (i / 3) * 8,
+                                      (i % 3) * 8 + 7, 2, (i / 3) * 8 + 7);
+
+    SparseBuffer &buffer = *fragment.drawing.sparse_buffer;
+    buffer.resize(fragment.width(), fragment.height());
+    for (size_t p = 0; p < fragment.width() * fragment.height(); p++) {
+      uint8_t *pixel = buffer.write(p % fragment.width(), p / fragment.width());
+      pixel[0] = 20 * i;
+      pixel[1] = p;
+      pixel[3] = p % 3 ? 255 : 100;
+    }
+
+    fragments.push_back(std::move(fragment));
+  }
+
+  fragments.emplace_back();
+
+  CompositeCanvas composite(std::move(fragments));
+
+  ASSERT_EQ(composite.width(), 4 * 24);
+
+  // The lines read through the index match the ones composed from all the
+  // fragments
+  for (uint64_t y = 0; y <= composite.height(); y++) {
+    std::vector<uint8_t> indexed(composite.width() * 4, 0),
+        scanned(composite.width() * 4, 0);
+
+    composite.getLine(indexed.data(), indexed.size(), y);
+    composite._get_line(*composite.drawing.canvas_buffer, scanned.data(),
+                        scanned.size(), y);
+
+    ASSERT_EQ(indexed, scanned);
+    ASSERT_EQ(indexed[(composite.width() / 2) * 4 + 3] != 0,
+              y < composite.height());
+  }
+}
+
+TEST(TestCanvas, TestFootprint) {
+  // A flat map leaves the corners of the rectangle out
+  World::Coordinates flat(0, 0, 0, 1023, 0, 1023);
+  ASSERT_LT(IsometricCanvas::footprint(flat), flat.footprint());
+  ASSERT_GE(IsometricCanvas::footprint(flat), flat.footprint() / 2);
+
+  // A tall map is counted at most as a full buffer
+  World::Coordinates small(0, -64, 0, 40, 319, 40);
+  IsometricCanvas canvas;
+  canvas.setMap(small);
+
+  size_t blocks = 0;
+  for (size_t y = 0; y < canvas.height + 1; y += SparseBuffer::block)
+    for (size_t x = 0; x < canvas.width; x += SparseBuffer::block)
+      blocks++;
+
+  ASSERT_LE(IsometricCanvas::footprint(small),
+            blocks * SparseBuffer::block * SparseBuffer::block * 4);
+}
+
+TEST(TestColorTables, TestEmpty) {
+  Colors::Palette colors;
+  Colors::load(&colors);
+  const Colors::Index index(colors);
+
+  ColorTables none, plain(index, false, false);
+
+  ASSERT_FALSE(none.shades(Colors::Index::air));
+  ASSERT_FALSE(none.lights(Colors::Index::air));
+  ASSERT_FALSE(plain.shades(Colors::Index::air));
+  ASSERT_FALSE(plain.lights(Colors::Index::air));
+}
+
+TEST(TestColorTables, TestLookup) {
+  using namespace mcmap::constants;
+
+  Colors::Palette colors;
+  Colors::load(&colors);
+  const Colors::Index index(colors);
+  const ColorTables tables(index, true, true);
+
+  const Colors::Index::id_t stone = index.find("minecraft:stone");
+  const Colors::Block &block = *index.block(stone);
+
+  ASSERT_TRUE(tables.shades(stone));
+  ASSERT_TRUE(tables.lights(stone));
+  ASSERT_FALSE(tables.shades(Colors::Index::unknown));
+  ASSERT_FALSE(tables.lights(Colors::Index::unknown));
+
+  // The profile goes from dark at the bottom of the world to bright at the top
+  ASSERT_LT(tables.shade(stone, min_y).primary.R, block.primary.R);
+  ASSERT_GT(tables.shade(stone, max_y).primary.R, block.primary.R);
+
+  for (uint8_t light = 0; light < 16; light++) {
+    Colors::Color dark = block.dark;
+    dark.modColor((lighting_dark + lighting_delta * light) *
+                  (block.dark.brightness() / 323.0f + .21f));
+
+    ASSERT_EQ(tables.lit(stone, light).dark, dark);
+    ASSERT_EQ(tables.emit(stone, light),
+              block.shade(lighting_dark + lighting_delta * light));
+  }
+}
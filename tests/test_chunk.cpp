@@ -1,12 +1,11 @@
 #include "../src/chunk.h"
-#include "../src/include/nbt/parser.hpp"
 #include "./samples.h"
 #include <gtest/gtest.h>
 
 TEST(TestChunkStatic, TestAssert) {
-  nbt::NBT chunk;
+  nbt::View chunk;
   ASSERT_FALSE(mcmap::Chunk::assert_chunk(chunk));
-  nbt::parse(chunk_nbt, chunk_nbt_len, chunk);
+  nbt::index(chunk_nbt, chunk_nbt_len, chunk);
   ASSERT_TRUE(mcmap::Chunk::assert_chunk(chunk));
 }
 
@@ -55,13 +54,15 @@ TEST_F(TestChunkCoordinates, TestModulo) {
 class TestChunk : public ::testing::Test {
 protected:
   Colors::Palette colors;
+  Colors::Index index;
   mcmap::Chunk chunk;
   TestChunk() {
     Colors::load(&colors);
-    nbt::NBT data;
-    nbt::parse(chunk_nbt, chunk_nbt_len, data);
+    index = Colors::Index(colors);
+    nbt::View data;
+    nbt::index(chunk_nbt, chunk_nbt_len, data);
 
-    chunk = mcmap::Chunk(data, colors, {0, 0});
+    chunk = mcmap::Chunk(data, index, {0, 0});
   }
 };
 
@@ -74,3 +75,30 @@ TEST_F(TestChunk, TestCreate) {
 
   ASSERT_FALSE(chunk.valid());
 }
+
+TEST_F(TestChunk, TestFiltered) {
+  nbt::View data;
+  nbt::index(chunk_nbt, chunk_nbt_len, data, &mcmap::Chunk::fields);
+
+  mcmap::Chunk filtered(data, index, {0, 0});
+
+  ASSERT_TRUE(filtered.valid());
+  ASSERT_EQ(filtered.data_version, chunk.data_version);
+  ASSERT_EQ(filtered.sections.size(), chunk.sections.size());
+
+  for (size_t i = 0; i < chunk.sections.size(); i++) {
+    ASSERT_EQ(filtered.sections[i].Y, chunk.sections[i].Y);
+    ASSERT_EQ(filtered.sections[i].blocks, chunk.sections[i].blocks);
+    ASSERT_EQ(filtered.sections[i].lights, chunk.sections[i].lights);
+  }
+}
+
+TEST_F(TestChunk, TestSectionLookup) {
+  for (const auto &section : chunk.sections)
+    ASSERT_EQ(chunk.section(section.Y)->Y, section.Y);
+
+  ASSERT_EQ(chunk.section(chunk.sections.back().Y + 1), chunk.sections.end());
+
+  const mcmap::Chunk empty;
+  ASSERT_EQ(empty.section(0), empty.sections.end());
+}
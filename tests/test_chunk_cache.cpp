@@ -0,0 +1,72 @@
+#include "../src/chunk_cache.h"
+#include "./samples.h"
+#include <gtest/gtest.h>
+
+class TestChunkCache : public ::testing::Test {
+protected:
+  Colors::Palette colors;
+  Colors::Index index;
+  mcmap::Chunk chunk;
+  fs::path root;
+
+  const Terrain::ChunkCache::Key key = {0x201, 1650000000, 0xdeadbeef};
+
+  TestChunkCache() {
+    Colors::load(&colors);
+    index = Colors::Index(colors);
+    root = fs::temp_directory_path() / "chunk_cache";
+    fs::create_directory(root);
+
+    nbt::View data;
+    nbt::index(chunk_nbt, chunk_nbt_len, data);
+    chunk = mcmap::Chunk(data, index, {33, -2});
+  }
+
+  ~TestChunkCache() { fs::remove_all(root); }
+};
+
+TEST_F(TestChunkCache, TestMissing) {
+  Terrain::ChunkCache cache(root, "world/region");
+
+  ASSERT_FALSE(cache.load({33, -2}, key, index).valid());
+}
+
+TEST_F(TestChunkCache, TestStoreLoad) {
+  Terrain::ChunkCache cache(root, "world/region");
+
+  ASSERT_TRUE(chunk.valid());
+  ASSERT_TRUE(cache.store(chunk, key, index));
+
+  const mcmap::Chunk cached = cache.load({33, -2}, key, index);
+
+  ASSERT_TRUE(cached.valid());
+  ASSERT_EQ(cached.position, chunk.position);
+  ASSERT_EQ(cached.data_version, chunk.data_version);
+  ASSERT_EQ(cached.sections.size(), chunk.sections.size());
+
+  for (size_t i = 0; i < chunk.sections.size(); i++) {
+    const Section &expected = chunk.sections[i], &section = cached.sections[i];
+
+    ASSERT_EQ(section.Y, expected.Y);
+    ASSERT_EQ(section.ids, expected.ids);
+    ASSERT_EQ(section.colors, expected.colors);
+    ASSERT_EQ(section.blocks, expected.blocks);
+    ASSERT_EQ(section.lights, expected.lights);
+    ASSERT_EQ(section.occluders, expected.occluders);
+    ASSERT_EQ(section.beaconIndex, expected.beaconIndex);
+
+    for (size_t j = 0; j < expected.states.size(); j++)
+      ASSERT_EQ(section.states[j].pack(), expected.states[j].pack());
+  }
+}
+
+TEST_F(TestChunkCache, TestStale) {
+  Terrain::ChunkCache cache(root, "world/region"), other(root, "other/region");
+  Terrain::ChunkCache::Key changed = key;
+  changed.timestamp++;
+
+  ASSERT_TRUE(cache.store(chunk, key, index));
+
+  ASSERT_FALSE(cache.load({33, -2}, changed, index).valid());
+  ASSERT_FALSE(other.load({33, -2}, key, index).valid());
+}
@@ -161,3 +161,71 @@ TEST(TestColorImport, TestLoadBadFormat) {
   ASSERT_FALSE(Colors::load(&p, json::from_bson(bad_palette)));
   ASSERT_FALSE(p.size());
 }
+
+TEST(TestIndex, TestFind) {
+  Colors::Palette palette;
+  Colors::load(&palette);
+  Colors::Index index(palette);
+
+  ASSERT_EQ(index.size(), palette.size());
+
+  for (const auto &defined : palette) {
+    const Colors::Index::id_t id = index.find(defined.first);
+
+    ASSERT_NE(id, Colors::Index::unknown);
+    ASSERT_EQ(index.name(id), defined.first);
+    ASSERT_EQ(*index.block(id), defined.second);
+  }
+
+  ASSERT_EQ(index.find("minecraft:air"), Colors::Index::air);
+  ASSERT_EQ(index.find("minecraft:beacon"), index.beacon);
+  ASSERT_EQ(index.find("minecraft:undefined"), Colors::Index::unknown);
+  ASSERT_EQ(index.find(""), Colors::Index::unknown);
+}
+
+TEST(TestIndex, TestEmpty) {
+  Colors::Index index;
+
+  ASSERT_EQ(index.size(), 1);
+  ASSERT_EQ(index.find("minecraft:air"), Colors::Index::air);
+  ASSERT_EQ(index.beacon, Colors::Index::unknown);
+}
+
+TEST(TestBlend, TestRows) {
+  // Every pair of alpha values, over 256 colors, in rows of 255 pixels to
+  // leave pixels to the scalar loop
+  for (uint16_t alpha = 0; alpha < 256; alpha++) {
+    for (uint16_t color = 0; color < 256; color++) {
+      std::vector<uint8_t> top(255 * 4), bottom(255 * 4);
+
+      for (uint16_t i = 0; i < 255; i++) {
+        const uint8_t pixel[4] = {uint8_t(color), uint8_t(i),
+                                  uint8_t(color ^ i), uint8_t(alpha)};
+        const uint8_t under[4] = {uint8_t(i), uint8_t(255 - color),
+                                  uint8_t(color), uint8_t(i + (color & 1))};
+        memcpy(&top[i * 4], pixel, 4);
+        memcpy(&bottom[i * 4], under, 4);
+      }
+
+      std::vector<uint8_t> expected = bottom, over = bottom;
+      std::vector<uint8_t> composed = top, under = top;
+
+      // Pixel by pixel, blending over the bottom row, or composing the top
+      // row over the bottom one as canvasses do
+      for (uint16_t i = 0; i < 255; i++) {
+        blend(&expected[i * 4], &top[i * 4]);
+
+        if (bottom[i * 4 + 3] && top[i * 4 + 3] != 0xff) {
+          memcpy(&composed[i * 4], &bottom[i * 4], 4);
+          blend(&composed[i * 4], &top[i * 4]);
+        }
+      }
+
+      blend(over.data(), top.data(), 255);
+      blend_under(under.data(), bottom.data(), 255);
+
+      ASSERT_EQ(over, expected);
+      ASSERT_EQ(under, composed);
+    }
+  }
+}
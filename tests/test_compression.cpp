@@ -0,0 +1,138 @@
+#include "../src/compression.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <zlib.h>
+
+namespace {
+
+// Data compressing well, larger than the buffer chunks used to be inflated in
+std::vector<uint8_t> sample(size_t size = 3 * 1024 * 1024) {
+  std::vector<uint8_t> data(size);
+
+  for (size_t i = 0; i < size; i++)
+    data[i] = (i * 7 + i / 4096) & 0xff;
+
+  return data;
+}
+
+// Deflate `data` with a zlib header, or a gzip header if `gzip` is set
+std::vector<uint8_t> deflate(const std::vector<uint8_t> &data, bool gzip) {
+  z_stream stream = {};
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+               MAX_WBITS + (gzip ? 16 : 0), 8, Z_DEFAULT_STRATEGY);
+
+  std::vector<uint8_t> output(deflateBound(&stream, data.size()));
+  stream.next_in = const_cast<uint8_t *>(data.data());
+  stream.avail_in = data.size();
+  stream.next_out = output.data();
+  stream.avail_out = output.size();
+
+  deflate(&stream, Z_FINISH);
+  output.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  return output;
+}
+
+// A block of an LZ4 stream as written by lz4-java
+std::vector<uint8_t> lz4_block(uint8_t method, const std::vector<uint8_t> &data,
+                               uint32_t decoded) {
+  const std::string magic = "LZ4Block";
+  std::vector<uint8_t> block(magic.begin(), magic.end());
+
+  block.push_back(method);
+  for (uint32_t value : {uint32_t(data.size()), decoded, uint32_t(0)})
+    for (int i = 0; i < 4; i++)
+      block.push_back(value >> (8 * i));
+
+  block.insert(block.end(), data.begin(), data.end());
+  return block;
+}
+
+void check(uint8_t type, const std::vector<uint8_t> &compressed,
+           const std::vector<uint8_t> &expected) {
+  std::vector<uint8_t> output;
+  size_t length = 0;
+
+  ASSERT_TRUE(Compression::decompress(type, compressed.data(),
+                                      compressed.size(), output, &length));
+  ASSERT_EQ(length, expected.size());
+  ASSERT_TRUE(std::equal(expected.begin(), expected.end(), output.begin()));
+}
+
+} // namespace
+
+TEST(TestCompression, TestZlib) {
+  const std::vector<uint8_t> data = sample();
+  check(Compression::ZLIB, deflate(data, false), data);
+}
+
+TEST(TestCompression, TestGzip) {
+  const std::vector<uint8_t> data = sample();
+  check(Compression::GZIP, deflate(data, true), data);
+}
+
+TEST(TestCompression, TestNone) {
+  const std::vector<uint8_t> data = sample(1000);
+  check(Compression::NONE, data, data);
+}
+
+TEST(TestCompression, TestReuse) {
+  // The decompressor and the buffer are used for chunks one after the other
+  const std::vector<uint8_t> large = sample(), small = sample(100);
+  std::vector<uint8_t> output;
+  size_t length;
+
+  for (const auto *data : {&large, &small, &large}) {
+    const std::vector<uint8_t> compressed = deflate(*data, false);
+
+    ASSERT_TRUE(Compression::decompress(Compression::ZLIB, compressed.data(),
+                                        compressed.size(), output, &length));
+    ASSERT_EQ(length, data->size());
+    ASSERT_TRUE(std::equal(data->begin(), data->end(), output.begin()));
+  }
+}
+
+TEST(TestCompression, TestLZ4) {
+  // "abc" followed by a match overlapping itself, then literals only
+  const std::vector<uint8_t> first = {0x35, 'a', 'b', 'c', 3, 0,
+                                      0x30, 'x', 'y', 'z'};
+  // A match whose length goes on in the next byte
+  const std::vector<uint8_t> second = {0x1f, 'a', 1, 0, 100, 0x10, 'b'};
+  const std::vector<uint8_t> raw = {'r', 'a', 'w'};
+
+  std::vector<uint8_t> stream, expected;
+
+  for (const auto &block :
+       {lz4_block(0x20, first, 15), lz4_block(0x25, second, 121),
+        lz4_block(0x10, raw, 3), lz4_block(0x10, {}, 0)})
+    stream.insert(stream.end(), block.begin(), block.end());
+
+  const std::string text =
+      "abcabcabcabcxyz" + std::string(120, 'a') + "b" + "raw";
+  expected.assign(text.begin(), text.end());
+
+  check(Compression::LZ4, stream, expected);
+}
+
+TEST(TestCompression, TestInvalid) {
+  const std::vector<uint8_t> data = sample(),
+                             compressed = deflate(data, false);
+  std::vector<uint8_t> output;
+  size_t length;
+
+  // Truncated stream
+  ASSERT_FALSE(Compression::decompress(Compression::ZLIB, compressed.data(),
+                                       compressed.size() / 2, output,
+                                       &length));
+
+  // Unknown compression
+  ASSERT_FALSE(Compression::decompress(127, compressed.data(),
+                                       compressed.size(), output, &length));
+
+  // A match reaching before the start of the block
+  const std::vector<uint8_t> block = {0x10, 'a', 4, 0, 0x00};
+  const std::vector<uint8_t> stream = lz4_block(0x20, block, 6);
+  ASSERT_FALSE(Compression::decompress(Compression::LZ4, stream.data(),
+                                       stream.size(), output, &length));
+}
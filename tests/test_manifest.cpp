@@ -0,0 +1,62 @@
+#include "../src/manifest.h"
+#include <gtest/gtest.h>
+
+class TestManifest : public ::testing::Test {
+protected:
+  Settings::WorldOptions options;
+  Colors::Palette colors;
+  std::vector<World::Coordinates> fragments;
+  fs::path directory;
+
+  TestManifest() {
+    directory = fs::temp_directory_path() / "manifest";
+    fs::create_directory(directory);
+
+    options.boundaries = World::Coordinates(0, 0, 0, 63, 10, 31);
+    options.boundaries.fragment(fragments, 32);
+  }
+
+  ~TestManifest() { fs::remove_all(directory); }
+};
+
+TEST_F(TestManifest, TestMissing) {
+  Manifest previous;
+
+  ASSERT_FALSE(previous.load(directory));
+  ASSERT_TRUE(previous.fragments.empty());
+
+  Manifest current(options, colors, fragments);
+
+  ASSERT_EQ(current.fragments.size(), 2);
+  ASSERT_FALSE(current.unchanged(previous, fragments[0]));
+}
+
+TEST_F(TestManifest, TestSaveLoad) {
+  Manifest current(options, colors, fragments), previous;
+  current.map = options.boundaries.to_string();
+  current.fragments[fragments[1].to_string()].empty = false;
+
+  ASSERT_TRUE(current.save(directory));
+  ASSERT_TRUE(previous.load(directory));
+
+  ASSERT_EQ(previous.settings, current.settings);
+  ASSERT_EQ(previous.map, current.map);
+  ASSERT_TRUE(previous.fragments[fragments[0].to_string()].empty);
+  ASSERT_FALSE(previous.fragments[fragments[1].to_string()].empty);
+
+  for (const auto &fragment : fragments)
+    ASSERT_TRUE(current.unchanged(previous, fragment));
+}
+
+TEST_F(TestManifest, TestSettings) {
+  Manifest previous(options, colors, fragments);
+
+  // The output does not change the drawing
+  options.outFile = "elsewhere.png";
+  ASSERT_TRUE(Manifest(options, colors, fragments)
+                  .unchanged(previous, fragments[0]));
+
+  options.shading = true;
+  ASSERT_FALSE(Manifest(options, colors, fragments)
+                   .unchanged(previous, fragments[0]));
+}
@@ -1,6 +1,7 @@
 #include "./samples.h"
 #include <gtest/gtest.h>
 #include <nbt/parser.hpp>
+#include <nbt/view.hpp>
 
 #define BUFFERSIZE 2000000
 
@@ -224,6 +225,112 @@ TEST_F(TestNBTParse, TestListIterator) {
   ASSERT_NE(find(angles.begin(), angles.end(), 1), angles.end());
 }
 
+class TestNBTView : public ::testing::Test {
+protected:
+  nbt::NBT level;
+  nbt::View view;
+
+  TestNBTView() {
+    nbt::parse(level_nbt, level_nbt_len, level);
+    nbt::index(level_nbt, level_nbt_len, view);
+  }
+};
+
+TEST_F(TestNBTView, TestIndex) {
+  ASSERT_TRUE(view.is_compound());
+  ASSERT_EQ(view.size(), level.size());
+  ASSERT_EQ(view["Data"].size(), level["Data"].size());
+  ASSERT_FALSE(view.contains("Missing"));
+  ASSERT_THROW(view["Missing"], std::out_of_range);
+}
+
+TEST_F(TestNBTView, TestAccessValues) {
+  const nbt::View &data = view["Data"];
+
+  ASSERT_EQ(data["DataVersion"].get<int32_t>(),
+            level["Data"]["DataVersion"].get<int32_t>());
+  ASSERT_EQ(data["Difficulty"].get<uint8_t>(),
+            level["Data"]["Difficulty"].get<uint8_t>());
+  ASSERT_EQ(data["DayTime"].get<uint64_t>(),
+            level["Data"]["DayTime"].get<uint64_t>());
+  ASSERT_EQ(data["BorderSafeZone"].get<double>(),
+            level["Data"]["BorderSafeZone"].get<double>());
+  ASSERT_EQ(data["LevelName"].get<std::string>(),
+            level["Data"]["LevelName"].get<std::string>());
+}
+
+TEST_F(TestNBTView, TestList) {
+  const nbt::View &gateways = view["Data"]["DragonFight"]["Gateways"];
+  const nbt::NBT &reference = level["Data"]["DragonFight"]["Gateways"];
+
+  ASSERT_TRUE(gateways.is_list());
+  ASSERT_EQ(gateways.size(), reference.size());
+
+  for (size_t i = 0; i < gateways.size(); i++)
+    ASSERT_EQ(gateways[i].get<int>(), reference[i].get<int>());
+}
+
+TEST_F(TestNBTView, TestArray) {
+  nbt::View chunk;
+  nbt::NBT reference;
+
+  nbt::index(chunk_nbt, chunk_nbt_len, chunk);
+  nbt::parse(chunk_nbt, chunk_nbt_len, reference);
+
+  auto states = chunk["Level"]["Sections"][1]["BlockStates"].array<int64_t>();
+  auto *expected = reference["Level"]["Sections"][1]["BlockStates"]
+                       .get<const nbt::NBT::tag_long_array_t *>();
+
+  ASSERT_EQ(states.size(), expected->size());
+  for (size_t i = 0; i < states.size(); i++)
+    ASSERT_EQ(states[i], expected->at(i));
+
+  ASSERT_THROW(chunk["Level"]["Sections"][1]["BlockStates"].array<int8_t>(),
+               std::invalid_argument);
+}
+
+TEST_F(TestNBTView, TestCopy) {
+  nbt::NBT copy = view["Data"]["DragonFight"].nbt();
+
+  ASSERT_EQ(copy.get_name(), "DragonFight");
+  ASSERT_EQ(copy.size(), level["Data"]["DragonFight"].size());
+  ASSERT_EQ(copy["Gateways"].size(),
+            level["Data"]["DragonFight"]["Gateways"].size());
+}
+
+TEST_F(TestNBTView, TestFilter) {
+  nbt::View filtered;
+  nbt::Filter filter = {{"Data", {{"DataVersion", {}}}}};
+
+  ASSERT_TRUE(nbt::index(level_nbt, level_nbt_len, filtered, &filter));
+  ASSERT_EQ(filtered["Data"].size(), 1);
+  ASSERT_TRUE(filtered["Data"].contains("DataVersion"));
+}
+
+TEST_F(TestNBTView, TestTruncated) {
+  nbt::View truncated;
+
+  ASSERT_FALSE(nbt::index(level_nbt, level_nbt_len / 2, truncated));
+  ASSERT_TRUE(truncated.is_end());
+}
+
+TEST(TestNBTCorrupt, TestEndList) {
+  // A compound holding a list of 2^32 - 1 end tags
+  const uint8_t data[] = {0x0a, 0x00, 0x00, 0x09, 0x00, 0x01, 'l', 0x00,
+                          0xff, 0xff, 0xff, 0xff, 0x00};
+  nbt::View corrupt;
+
+  ASSERT_FALSE(nbt::index(data, sizeof(data), corrupt));
+
+  // Empty lists are written as lists of end tags
+  const uint8_t empty[] = {0x0a, 0x00, 0x00, 0x09, 0x00, 0x01, 'l',
+                           0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  nbt::View valid;
+
+  ASSERT_TRUE(nbt::index(empty, sizeof(empty), valid));
+  ASSERT_EQ(valid["l"].size(), 0);
+}
+
 TEST(TestNBTIterator, TestEndIterator) {
   nbt::NBT end;
 
@@ -0,0 +1,227 @@
+#include "../src/canvas.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace {
+
+const uint8_t red[4] = {255, 0, 0, 255}, blue[4] = {0, 0, 255, 128};
+
+// A line with every kind of run: transparent pixels, a single color, and
+// pixels of different colors
+std::vector<uint8_t> sample(size_t width) {
+  std::vector<uint8_t> line(width * 4, 0);
+
+  for (size_t x = 10; x < 40; x++)
+    memcpy(&line[x * 4], red, 4);
+
+  for (size_t x = 40; x < 60; x++)
+    memcpy(&line[x * 4], x % 2 ? red : blue, 4);
+
+  for (size_t x = 60; x < width - 5; x++)
+    memcpy(&line[x * 4], blue, 4);
+
+  return line;
+}
+
+} // namespace
+
+TEST(TestPacked, TestRoundTrip) {
+  const std::vector<uint8_t> line = sample(100);
+  PackedImage image(100, 2);
+
+  image.add(line.data());
+  image.add(line.data());
+
+  ASSERT_LT(image.memory(), line.size());
+
+  for (uint64_t y = 0; y < 2; y++) {
+    std::vector<uint8_t> decoded(100 * 4, 0);
+    image.blend(y, decoded.data(), 100);
+    ASSERT_EQ(decoded, line);
+  }
+}
+
+TEST(TestPacked, TestCount) {
+  const std::vector<uint8_t> line = sample(100);
+  PackedImage image(100, 1);
+  image.add(line.data());
+
+  // Only the pixels asked for are written
+  std::vector<uint8_t> decoded(100 * 4, 0);
+  image.blend(0, decoded.data(), 20);
+
+  for (size_t x = 0; x < 100; x++)
+    ASSERT_EQ(decoded[x * 4 + 3], x >= 10 && x < 20 ? 255 : 0);
+}
+
+TEST(TestPacked, TestBlend) {
+  const std::vector<uint8_t> line = sample(100);
+  PackedImage image(100, 1);
+  image.add(line.data());
+
+  // The line is drawn under the buffer: opaque pixels are left as is, and
+  // transparent pixels of the line leave the buffer untouched
+  const uint8_t green[4] = {0, 255, 0, 255};
+  std::vector<uint8_t> decoded(100 * 4, 0);
+  memcpy(&decoded[0], green, 4);
+  memcpy(&decoded[20 * 4], green, 4);
+
+  image.blend(0, decoded.data(), 100);
+
+  ASSERT_EQ(memcmp(&decoded[0], green, 4), 0);
+  ASSERT_EQ(memcmp(&decoded[20 * 4], green, 4), 0);
+  ASSERT_EQ(memcmp(&decoded[21 * 4], red, 4), 0);
+  ASSERT_EQ(decoded[99 * 4 + 3], 0);
+}
+
+TEST(TestPacked, TestLongRuns) {
+  // Runs longer than a run header can hold are split
+  const size_t width = 40000;
+  std::vector<uint8_t> line(width * 4, 0);
+
+  for (size_t x = 20000; x < width; x++)
+    memcpy(&line[x * 4], red, 4);
+
+  PackedImage image(width, 1);
+  image.add(line.data());
+
+  std::vector<uint8_t> decoded(width * 4, 0);
+  image.blend(0, decoded.data(), width);
+  ASSERT_EQ(decoded, line);
+}
+
+TEST(TestPacked, TestSpill) {
+  const fs::path scratch = fs::temp_directory_path() / "packed";
+  const std::vector<uint8_t> line = sample(100);
+  PackedImage image(100, 3);
+
+  for (uint8_t y = 0; y < 3; y++)
+    image.add(line.data());
+
+  ASSERT_TRUE(image.spill(scratch));
+  ASSERT_EQ(image.memory(), 0);
+
+  std::vector<uint8_t> decoded(100 * 4, 0);
+  image.blend(2, decoded.data(), 100);
+  ASSERT_EQ(decoded, line);
+}
+
+TEST(TestPacked, TestCanvas) {
+  Canvas canvas(Canvas::SPARSE);
+  canvas.map = World::Coordinates(0, 0, 0, 7, 0, 7);
+  canvas.drawing.sparse_buffer->resize(canvas.width(), canvas.height());
+
+  for (size_t y = 0; y < canvas.height(); y++)
+    for (size_t x = y; x < canvas.width(); x++)
+      memcpy(canvas.drawing.sparse_buffer->write(x, y), x % 3 ? red : blue, 4);
+
+  PackedCanvas packed(canvas);
+
+  ASSERT_EQ(packed.width(), canvas.width());
+  ASSERT_EQ(packed.height(), canvas.height());
+
+  for (size_t y = 0; y < canvas.height(); y++) {
+    std::vector<uint8_t> expected(canvas.width() * 4, 0),
+        decoded(canvas.width() * 4, 0);
+
+    canvas.getLine(expected.data(), expected.size(), y);
+    packed.getLine(decoded.data(), decoded.size(), y);
+    ASSERT_EQ(decoded, expected);
+  }
+}
+
+TEST(TestPacked, TestSaveLoad) {
+  const fs::path file = fs::temp_directory_path() / "saved.packed";
+  const std::vector<uint8_t> line = sample(100);
+  PackedImage image(100, 3);
+
+  for (uint8_t y = 0; y < 3; y++)
+    image.add(line.data());
+
+  ASSERT_TRUE(image.save(file));
+
+  PackedImage loaded(file);
+  fs::remove(file);
+
+  ASSERT_TRUE(loaded.valid());
+  ASSERT_EQ(loaded.width, 100);
+  ASSERT_EQ(loaded.height, 3);
+
+  std::vector<uint8_t> decoded(100 * 4, 0);
+  loaded.blend(1, decoded.data(), 100);
+  ASSERT_EQ(decoded, line);
+}
+
+TEST(TestPacked, TestInvalid) {
+  const fs::path file = fs::temp_directory_path() / "invalid.packed";
+  std::ofstream(file) << "Not a packed image";
+
+  PackedImage loaded(file);
+  fs::remove(file);
+
+  ASSERT_FALSE(loaded.valid());
+
+  // Nothing is read from an invalid image
+  std::vector<uint8_t> decoded(16, 0);
+  loaded.blend(0, decoded.data(), 4);
+  ASSERT_EQ(decoded, std::vector<uint8_t>(16, 0));
+}
+
+TEST(TestPacked, TestConcurrentLines) {
+  // Every line is different, and read in any order from several threads
+  const size_t width = 64, height = 256;
+  PackedImage image(width, height);
+
+  auto expected = [](size_t y) {
+    std::vector<uint8_t> line(width * 4, 0);
+    for (size_t x = y % width; x < width; x++)
+      line[x * 4] = y, line[x * 4 + 3] = 255;
+    return line;
+  };
+
+  for (size_t y = 0; y < height; y++)
+    image.add(expected(y).data());
+
+  ASSERT_TRUE(image.spill(fs::temp_directory_path() / "concurrent.packed"));
+
+  std::atomic<size_t> mismatches(0);
+  std::vector<std::thread> threads;
+
+  for (size_t t = 0; t < 4; t++)
+    threads.emplace_back([&, t] {
+      for (size_t i = 0; i < height; i++) {
+        const size_t y = (i * 7 + t * 31) % height;
+        std::vector<uint8_t> decoded(width * 4, 0);
+        image.blend(y, decoded.data(), width);
+        mismatches += decoded != expected(y);
+      }
+    });
+
+  for (auto &thread : threads)
+    thread.join();
+
+  ASSERT_EQ(mismatches, 0);
+}
+
+TEST(TestPacked, TestPackedCanvasFile) {
+  const fs::path file = fs::temp_directory_path() / "canvas.packed";
+  World::Coordinates map(0, 0, 0, 7, 0, 7);
+
+  Canvas canvas(Canvas::SPARSE);
+  canvas.map = map;
+  canvas.drawing.sparse_buffer->resize(canvas.width(), canvas.height());
+
+  for (size_t y = 0; y < canvas.height(); y++)
+    for (size_t x = 0; x < canvas.width(); x++)
+      memset(canvas.drawing.sparse_buffer->write(x, y), 255, 4);
+
+  ASSERT_TRUE(PackedCanvas(canvas).image().save(file));
+  ASSERT_EQ(PackedCanvas(map, file).type, Canvas::PACKED);
+
+  // An image of another size is not used
+  map.maxX = 15;
+  ASSERT_EQ(PackedCanvas(map, file).type, Canvas::EMPTY);
+
+  fs::remove(file);
+}
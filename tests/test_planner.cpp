@@ -0,0 +1,82 @@
+#include "../src/planner.h"
+#include <gtest/gtest.h>
+
+// Whether a chunk is in one of the fragments
+size_t covering(const std::vector<World::Coordinates> &fragments, int32_t x,
+                int32_t z) {
+  size_t count = 0;
+
+  for (const auto &fragment : fragments)
+    if (CHUNK(fragment.minX) <= x && x <= CHUNK(fragment.maxX) &&
+        CHUNK(fragment.minZ) <= z && z <= CHUNK(fragment.maxZ))
+      count++;
+
+  return count;
+}
+
+TEST(TestPlanner, TestEmpty) {
+  Planner planner(World::Coordinates(0, 0, 0, 1023, 10, 1023));
+  std::vector<World::Coordinates> fragments;
+
+  planner.fragment(fragments, 256);
+  ASSERT_TRUE(fragments.empty());
+}
+
+TEST(TestPlanner, TestShrink) {
+  Planner planner(World::Coordinates(-512, 0, -512, 511, 10, 511));
+  std::vector<World::Coordinates> fragments;
+
+  planner.add(2, 3);
+  planner.add(4, 5);
+  // Outside of the map
+  planner.add(100, 0);
+
+  planner.fragment(fragments, 1024);
+
+  ASSERT_EQ(fragments.size(), 1);
+  ASSERT_EQ(fragments[0], World::Coordinates(32, 0, 48, 79, 10, 95));
+}
+
+TEST(TestPlanner, TestSplit) {
+  Planner planner(World::Coordinates(0, 0, 0, 1023, 10, 1023));
+  std::vector<World::Coordinates> fragments;
+
+  // A dense area, and a couple isolated chunks
+  for (int32_t x = 0; x < 20; x++)
+    for (int32_t z = 0; z < 12; z++)
+      planner.add(x, z);
+
+  planner.add(60, 60);
+  planner.add(63, 2);
+
+  planner.fragment(fragments, 128);
+
+  // Every chunk is drawn once, in fragments at most 8 chunks wide
+  for (int32_t x = 0; x < 64; x++)
+    for (int32_t z = 0; z < 64; z++)
+      ASSERT_EQ(covering(fragments, x, z),
+                (x < 20 && z < 12) || (x == 60 && z == 60) ||
+                        (x == 63 && z == 2)
+                    ? 1
+                    : 0);
+
+  for (const auto &fragment : fragments) {
+    ASSERT_LE(fragment.sizeX(), 128);
+    ASSERT_LE(fragment.sizeZ(), 128);
+  }
+}
+
+TEST(TestPlanner, TestBoundaries) {
+  Planner planner(World::Coordinates(5, 0, 7, 100, 10, 90));
+  std::vector<World::Coordinates> fragments;
+
+  for (int32_t x = 0; x < 7; x++)
+    for (int32_t z = 0; z < 6; z++)
+      planner.add(x, z);
+
+  planner.fragment(fragments, 1024);
+
+  // The fragments do not go over the boundaries of the map
+  ASSERT_EQ(fragments.size(), 1);
+  ASSERT_EQ(fragments[0], World::Coordinates(5, 0, 7, 100, 10, 90));
+}
@@ -0,0 +1,64 @@
+#include "../src/png.h"
+#include <gtest/gtest.h>
+
+class TestParallelWriter : public ::testing::Test {
+protected:
+  fs::path file;
+  const uint32_t width = 37, height = 101;
+
+  TestParallelWriter() { file = fs::temp_directory_path() / "parallel.png"; }
+  ~TestParallelWriter() { fs::remove(file); }
+
+  uint8_t pixel(uint32_t x, uint32_t y, uint8_t channel) {
+    return uint8_t(x * 7 + y * 13 + channel * 31 + (x * y) % 5);
+  }
+};
+
+TEST_F(TestParallelWriter, TestEmpty) {
+  PNG::ParallelWriter output(file, 0, 0);
+
+  ASSERT_FALSE(output.is_open());
+  ASSERT_FALSE(output.close());
+}
+
+TEST_F(TestParallelWriter, TestIncomplete) {
+  PNG::ParallelWriter output(file, width, height);
+
+  ASSERT_TRUE(output.is_open());
+  ASSERT_TRUE(output.commit(1));
+  ASSERT_FALSE(output.close());
+}
+
+TEST_F(TestParallelWriter, TestReadBack) {
+  // Small bands for the image to span several batches and bands
+  PNG::ParallelWriter output(file, width, height, {{"Software", "test"}}, 3);
+
+  for (uint32_t y = 0; y < height;) {
+    const size_t count = std::min(output.batch(), size_t(height - y));
+
+    for (size_t i = 0; i < count; i++)
+      for (uint32_t x = 0; x < width; x++)
+        for (uint8_t c = 0; c < 4; c++)
+          output.row(i)[x * 4 + c] = pixel(x, y + i, c);
+
+    ASSERT_TRUE(output.commit(count));
+    y += count;
+  }
+
+  ASSERT_TRUE(output.close());
+
+  PNG::PNGReader input(file);
+  ASSERT_EQ(input.get_width(), width);
+  ASSERT_EQ(input.get_height(), height);
+  ASSERT_EQ(input._type, PNG::RGBA);
+
+  std::vector<uint8_t> line(width * 4);
+
+  for (uint32_t y = 0; y < height; y++) {
+    ASSERT_EQ(input.getLine(line.data(), line.size()), width);
+
+    for (uint32_t x = 0; x < width; x++)
+      for (uint8_t c = 0; c < 4; c++)
+        ASSERT_EQ(line[x * 4 + c], pixel(x, y, c));
+  }
+}
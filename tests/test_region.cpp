@@ -0,0 +1,104 @@
+#include "../src/region.h"
+#include "./samples.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+class TestRegion : public ::testing::Test {
+protected:
+  fs::path file;
+  std::vector<uint8_t> compressed;
+
+  TestRegion() {
+    file = fs::temp_directory_path() / "r.-1.2.mca";
+
+    uLongf size = compressBound(chunk_nbt_len);
+    compressed.resize(size);
+    compress(compressed.data(), &size, chunk_nbt, chunk_nbt_len);
+    compressed.resize(size);
+
+    // Write a region file with the sample chunk as chunk 33 (1, 1)
+    const uint32_t length = compressed.size() + 1;
+    const uint8_t sectors = (length + 4 + 4095) / 4096;
+    std::vector<uint8_t> contents((2 + sectors) * 4096, 0);
+
+    const uint32_t location = (2 << 8) | sectors;
+    const uint32_t timestamp = 1650000000;
+    for (int i = 0; i < 4; i++) {
+      contents[33 * 4 + i] = location >> (24 - 8 * i);
+      contents[4096 + 33 * 4 + i] = timestamp >> (24 - 8 * i);
+      contents[2 * 4096 + i] = length >> (24 - 8 * i);
+    }
+    contents[2 * 4096 + 4] = 2;
+    memcpy(&contents[2 * 4096 + 5], compressed.data(), compressed.size());
+
+    std::ofstream out(file, std::ofstream::binary);
+    out.write((char *)contents.data(), contents.size());
+  }
+
+  ~TestRegion() { fs::remove(file); }
+};
+
+TEST_F(TestRegion, TestCoordinates) {
+  auto coordinates = Region::coordinates(file);
+
+  ASSERT_EQ(coordinates.first, -1);
+  ASSERT_EQ(coordinates.second, 2);
+}
+
+TEST_F(TestRegion, TestMissing) {
+  Region r(fs::temp_directory_path() / "r.1000.1000.mca");
+
+  ASSERT_FALSE(r.valid());
+  ASSERT_TRUE(r.chunk(0).empty());
+}
+
+TEST_F(TestRegion, TestLocations) {
+  Region r(file);
+
+  ASSERT_TRUE(r.valid());
+
+  for (uint16_t chunk = 0; chunk < REGIONSIZE * REGIONSIZE; chunk++) {
+    if (chunk == 33) {
+      ASSERT_EQ(r.locations[chunk].offset(), 2);
+      ASSERT_FALSE(r.chunk(chunk).empty());
+    } else {
+      ASSERT_EQ(r.locations[chunk].raw_data, 0);
+      ASSERT_TRUE(r.chunk(chunk).empty());
+    }
+  }
+}
+
+TEST_F(TestRegion, TestTimestamps) {
+  Region r(file);
+
+  ASSERT_EQ(r.timestamps[33], 1650000000);
+  ASSERT_EQ(r.timestamps[32], 0);
+
+  // The timestamps are written back with the header
+  const fs::path copy = fs::temp_directory_path() / "r.-1.3.mca";
+  r.write(copy);
+
+  Region written(copy);
+  fs::remove(copy);
+
+  ASSERT_EQ(written.timestamps, r.timestamps);
+  ASSERT_EQ(written.locations[33].raw_data, r.locations[33].raw_data);
+}
+
+TEST_F(TestRegion, TestChunkData) {
+  Region r(file);
+  ChunkData data = r.chunk(33);
+
+  ASSERT_EQ(data.compression, 2);
+  ASSERT_EQ(data.size, compressed.size());
+  ASSERT_EQ(memcmp(data.data, compressed.data(), data.size), 0);
+}
+
+TEST_F(TestRegion, TestMove) {
+  Region r(file);
+  Region moved(std::move(r));
+
+  ASSERT_FALSE(r.valid());
+  ASSERT_TRUE(moved.valid());
+  ASSERT_FALSE(moved.chunk(33).empty());
+}
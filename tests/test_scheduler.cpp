@@ -0,0 +1,50 @@
+#include "../src/scheduler.h"
+#include <gtest/gtest.h>
+
+TEST(TestScheduler, TestRun) {
+  Scheduler scheduler(4);
+  std::atomic<size_t> done(0);
+
+  ASSERT_EQ(scheduler.size(), 4);
+
+  for (size_t i = 0; i < 100; i++)
+    scheduler.submit([&done] { done++; });
+
+  scheduler.run();
+  ASSERT_EQ(done, 100);
+
+  // The scheduler can be run again
+  scheduler.submit([&done] { done++; });
+  scheduler.run();
+  ASSERT_EQ(done, 101);
+}
+
+TEST(TestScheduler, TestSplit) {
+  Scheduler scheduler(3);
+  std::atomic<size_t> done(0);
+
+  // Tasks submitted by tasks are waited for as well
+  for (size_t i = 0; i < 10; i++)
+    scheduler.submit([&scheduler, &done] {
+      for (size_t j = 0; j < 10; j++)
+        scheduler.submit([&done] { done++; });
+    });
+
+  scheduler.run();
+  ASSERT_EQ(done, 100);
+}
+
+TEST(TestScheduler, TestSingle) {
+  Scheduler scheduler(1);
+  const std::thread::id caller = std::this_thread::get_id();
+  bool here = false;
+
+  // Without other workers, the tasks run on the calling thread
+  scheduler.submit([&here, caller] {
+    here = std::this_thread::get_id() == caller;
+  });
+
+  ASSERT_FALSE(scheduler.starving());
+  scheduler.run();
+  ASSERT_TRUE(here);
+}
@@ -1,4 +1,4 @@
-#include "../src/include/nbt/parser.hpp"
+#include "../src/chunk_format_versions/section_format.hpp"
 #include "../src/section.h"
 #include "./samples.h"
 #include <gtest/gtest.h>
@@ -6,17 +6,18 @@
 class TestSection : public ::testing::Test {
 protected:
   Colors::Palette colors;
-  nbt::NBT sections;
+  Colors::Index index;
+  nbt::View chunk, sections;
   int dataVersion;
 
   TestSection() {
-    nbt::NBT chunk;
-    nbt::parse(chunk_nbt, chunk_nbt_len, chunk);
+    nbt::index(chunk_nbt, chunk_nbt_len, chunk);
 
     dataVersion = chunk["DataVersion"].get<int>();
     sections = chunk["Level"]["Sections"];
 
     Colors::load(&colors);
+    index = Colors::Index(colors);
   }
 };
 
@@ -30,8 +31,7 @@ TEST_F(TestSection, TestCreateEmpty) {
 }
 
 TEST_F(TestSection, TestCreateFromEmpty) {
-  Section s(sections[0], dataVersion);
-  s.loadPalette(colors);
+  Section s(sections[0], dataVersion, index);
 
   for (uint8_t x = 0; x < 16; x++)
     for (uint8_t y = 0; y < 16; y++)
@@ -39,13 +39,26 @@ TEST_F(TestSection, TestCreateFromEmpty) {
         ASSERT_EQ(s.color_at(x, y, z)->primary.ALPHA, 0);
 }
 
+TEST_F(TestSection, TestEmpty) {
+  ASSERT_TRUE(Section().empty());
+  ASSERT_TRUE(Section(sections[0], dataVersion, index).empty());
+  ASSERT_FALSE(Section(sections[1], dataVersion, index).empty());
+}
+
+TEST_F(TestSection, TestIdentifiers) {
+  Section s(sections[1], dataVersion, index);
+
+  ASSERT_EQ(s.ids.size(), s.colors.size());
+  for (size_t i = 0; i < s.ids.size(); i++)
+    ASSERT_EQ(s.colors[i], index.block(s.ids[i]));
+}
+
 TEST_F(TestSection, TestColorPresence) {
   auto query = colors.find("minecraft:bedrock");
   bool presence = false;
 
   Colors::Block bedrock = query->second;
-  Section s(sections[1], dataVersion);
-  s.loadPalette(colors);
+  Section s(sections[1], dataVersion, index);
 
   ASSERT_NE(s.colors.size(), 0);
 
@@ -59,20 +72,188 @@ TEST_F(TestSection, TestColor) {
   auto query = colors.find("minecraft:bedrock");
 
   Colors::Block bedrock = query->second;
-  Section s(sections[1], dataVersion);
-  s.loadPalette(colors);
+  Section s(sections[1], dataVersion, index);
 
   for (uint8_t x = 0; x < 16; x++)
     for (uint8_t z = 0; z < 16; z++)
       ASSERT_EQ(*s.color_at(x, 0, z), bedrock);
 }
 
+TEST_F(TestSection, TestOccluders) {
+  Section s(sections[1], dataVersion, index);
+
+  // The bedrock layer hides whatever is drawn behind it
+  ASSERT_TRUE(s.occludes(0, 0, 0));
+
+  for (uint8_t x = 0; x < 16; x++)
+    for (uint8_t y = 0; y < 16; y++)
+      for (uint8_t z = 0; z < 16; z++)
+        ASSERT_EQ(s.occludes(x, y, z), s.color_at(x, y, z)->occludes());
+
+  ASSERT_FALSE(Section().occludes(0, 0, 0));
+}
+
 TEST_F(TestSection, TestMetadata) {
-  Section s(sections[1], dataVersion);
-  s.loadPalette(colors);
+  Section s(sections[1], dataVersion, index);
 
-  const nbt::NBT &state = s.state_at(0, 0, 0);
+  ASSERT_EQ(index.name(s.ids[s.block_at(0, 0, 0)]), "minecraft:bedrock");
+  ASSERT_EQ(s.states.size(), s.ids.size());
+}
 
-  ASSERT_TRUE(state.contains("Name"));
-  ASSERT_EQ(state["Name"].get<string>(), "minecraft:bedrock");
+// Serialize a palette entry with the given string properties
+std::vector<uint8_t>
+palette_entry(const std::vector<std::pair<string, string>> &properties) {
+  std::vector<uint8_t> data = {10, 0, 0, 10, 0, 10};
+  const string compound = "Properties";
+  data.insert(data.end(), compound.begin(), compound.end());
+
+  for (const auto &property : properties) {
+    data.push_back(8);
+    data.push_back(0);
+    data.push_back(property.first.size());
+    data.insert(data.end(), property.first.begin(), property.first.end());
+    data.push_back(0);
+    data.push_back(property.second.size());
+    data.insert(data.end(), property.second.begin(), property.second.end());
+  }
+
+  // Close both compounds
+  data.push_back(0);
+  data.push_back(0);
+  return data;
 }
+
+TEST(TestBlockState, TestDefault) {
+  BlockState state;
+  nbt::View entry;
+  const std::vector<uint8_t> data = palette_entry({});
+
+  ASSERT_TRUE(nbt::index(data.data(), data.size(), entry));
+  ASSERT_EQ(BlockState(entry).facing, state.facing);
+  ASSERT_EQ(BlockState(entry).shape, BlockState::STRAIGHT);
+  ASSERT_EQ(BlockState(entry).slab, BlockState::SLAB_BOTTOM);
+  ASSERT_FALSE(BlockState(entry).waterlogged);
+}
+
+TEST(TestBlockState, TestProperties) {
+  nbt::View entry;
+  const std::vector<uint8_t> data = palette_entry({{"facing", "east"},
+                                                   {"half", "top"},
+                                                   {"shape", "outer_left"},
+                                                   {"type", "double"},
+                                                   {"axis", "z"},
+                                                   {"lit", "true"},
+                                                   {"waterlogged", "true"}});
+
+  ASSERT_TRUE(nbt::index(data.data(), data.size(), entry));
+  BlockState state(entry);
+
+  ASSERT_EQ(state.facing, BlockState::EAST);
+  ASSERT_EQ(state.half, BlockState::TOP);
+  ASSERT_EQ(state.shape, BlockState::OUTER);
+  ASSERT_EQ(state.slab, BlockState::SLAB_DOUBLE);
+  ASSERT_EQ(state.axis, BlockState::Z);
+  ASSERT_TRUE(state.lit);
+  ASSERT_TRUE(state.waterlogged);
+  ASSERT_FALSE(state.underwater);
+}
+
+TEST(TestBlockState, TestPack) {
+  BlockState state;
+  state.facing = BlockState::SOUTH;
+  state.half = BlockState::TOP;
+  state.axis = BlockState::X;
+  state.shape = BlockState::INNER_RIGHT;
+  state.slab = BlockState::SLAB_DOUBLE;
+  state.waterlogged = true;
+
+  const BlockState unpacked = BlockState::unpack(state.pack());
+
+  ASSERT_EQ(unpacked.facing, state.facing);
+  ASSERT_EQ(unpacked.half, state.half);
+  ASSERT_EQ(unpacked.axis, state.axis);
+  ASSERT_EQ(unpacked.shape, state.shape);
+  ASSERT_EQ(unpacked.slab, state.slab);
+  ASSERT_EQ(unpacked.lit, state.lit);
+  ASSERT_EQ(unpacked.underwater, state.underwater);
+  ASSERT_EQ(unpacked.waterlogged, state.waterlogged);
+  ASSERT_EQ(BlockState().pack(), 0);
+}
+
+// Get the `length` bits at position `bit` in an array of longs
+uint16_t bits_at(const std::vector<uint64_t> &longs, size_t bit,
+                 uint8_t length) {
+  uint16_t value = 0;
+
+  for (uint8_t i = 0; i < length; i++)
+    value |= ((longs[(bit + i) / 64] >> ((bit + i) % 64)) & 1) << i;
+
+  return value;
+}
+
+class TestBlockStates : public ::testing::TestWithParam<uint8_t> {
+protected:
+  std::vector<uint64_t> longs;
+  std::vector<uint8_t> data;
+
+  TestBlockStates() {
+    // Enough pseudo-random longs for any format
+    uint64_t state = 0x9e3779b97f4a7c15;
+    longs.resize(1024);
+
+    for (auto &value : longs) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      value = state;
+    }
+
+    // Store them as in the chunk data, in big-endian order
+    data.resize(8 * longs.size());
+    for (size_t i = 0; i < longs.size(); i++)
+      for (uint8_t byte = 0; byte < 8; byte++)
+        data[8 * i + byte] = longs[i] >> (56 - 8 * byte);
+  }
+};
+
+TEST_P(TestBlockStates, TestPost116) {
+  const uint8_t length = GetParam();
+  const uint8_t perLong = 64 / length;
+  Section::block_array buffer;
+
+  mcmap::versions::block_states_versions::post116(
+      length, {data.data(), longs.size()}, buffer);
+
+  for (uint16_t index = 0; index < 4096; index++) {
+    const size_t bit = 64 * (index / perLong) + length * (index % perLong);
+    ASSERT_EQ(buffer[index], bits_at(longs, bit, length));
+  }
+}
+
+TEST_P(TestBlockStates, TestPre116) {
+  const uint8_t length = GetParam();
+  Section::block_array buffer;
+
+  mcmap::versions::block_states_versions::pre116(
+      length, {data.data(), longs.size()}, buffer);
+
+  for (uint16_t index = 0; index < 4096; index++)
+    ASSERT_EQ(buffer[index], bits_at(longs, length * index, length));
+}
+
+TEST_P(TestBlockStates, TestTruncated) {
+  const uint8_t length = GetParam();
+  Section::block_array buffer;
+  buffer.fill(0);
+
+  mcmap::versions::block_states_versions::post116(length, {data.data(), 10},
+                                                  buffer);
+  mcmap::versions::block_states_versions::pre116(length, {data.data(), 10},
+                                                 buffer);
+
+  for (uint16_t index = 0; index < 4096; index++)
+    ASSERT_EQ(buffer[index], 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(TestBlockStatesLengths, TestBlockStates,
+                         ::testing::Range(uint8_t(4), uint8_t(14)));
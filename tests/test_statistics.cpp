@@ -0,0 +1,76 @@
+#include "../src/scheduler.h"
+#include "../src/statistics.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST(TestStatistics, TestCount) {
+  Statistics::Report &report = Statistics::current();
+  report.reset();
+
+  Statistics::count(Statistics::CHUNKS_DECODED);
+  Statistics::count(Statistics::BYTES_READ, 4096);
+  Statistics::count(Statistics::BYTES_READ, 10);
+
+  ASSERT_EQ(report.counters[Statistics::CHUNKS_DECODED], 1);
+  ASSERT_EQ(report.counters[Statistics::BYTES_READ], 4106);
+  ASSERT_EQ(report.counters[Statistics::SPILLS], 0);
+
+  report.reset();
+  ASSERT_EQ(report.counters[Statistics::BYTES_READ], 0);
+}
+
+TEST(TestStatistics, TestNestedTimers) {
+  Statistics::Report &report = Statistics::current();
+  report.reset();
+
+  {
+    Statistics::Timer draw(Statistics::DRAW);
+    std::this_thread::sleep_for(10ms);
+
+    {
+      Statistics::Timer inflate(Statistics::INFLATE);
+      std::this_thread::sleep_for(20ms);
+    }
+  }
+
+  // The time of the inner timer is not counted by the outer one
+  const uint64_t draw = report.stages[Statistics::DRAW],
+                 inflate = report.stages[Statistics::INFLATE];
+
+  ASSERT_GE(inflate, uint64_t(20e6));
+  ASSERT_GE(draw, uint64_t(10e6));
+  ASSERT_LT(draw, inflate);
+}
+
+TEST(TestStatistics, TestReport) {
+  Statistics::Report &report = Statistics::current();
+  report.reset();
+
+  Statistics::count(Statistics::SECTIONS_SKIPPED, 3);
+  report.busy = {500000000, 250000000};
+  report.drawing = 1000000000;
+  report.finish();
+
+  const json data = report.to_json();
+
+  ASSERT_EQ(data["counters"]["sectionsSkipped"], 3);
+  ASSERT_EQ(data["stages"].size(), Statistics::STAGES);
+  ASSERT_EQ(data["threads"].size(), 2);
+  ASSERT_DOUBLE_EQ(data["threads"][1]["utilization"].get<double>(), 0.25);
+  ASSERT_GT(data["peakMemory"].get<uint64_t>(), 0);
+}
+
+TEST(TestStatistics, TestSchedulerBusy) {
+  Scheduler scheduler(2);
+
+  for (size_t i = 0; i < 4; i++)
+    scheduler.submit([] { std::this_thread::sleep_for(5ms); });
+
+  scheduler.run();
+
+  const std::vector<uint64_t> busy = scheduler.busy();
+  ASSERT_EQ(busy.size(), 2);
+  ASSERT_GE(busy[0] + busy[1], uint64_t(20e6));
+}
@@ -0,0 +1,88 @@
+#include "../src/worldloader.h"
+#include <gtest/gtest.h>
+
+// A valid, empty chunk at the given position
+mcmap::Chunk placeholder(mcmap::Chunk::coordinates position) {
+  mcmap::Chunk chunk;
+  chunk.position = position;
+  chunk.data_version = 0;
+  chunk.sections.resize(1);
+  return chunk;
+}
+
+TEST(TestChunkStore, TestEmpty) {
+  Terrain::ChunkStore store;
+
+  ASSERT_EQ(store.find({0, 0}), nullptr);
+  store.insert(placeholder({0, 0}));
+  ASSERT_EQ(store.find({0, 0}), nullptr);
+}
+
+TEST(TestChunkStore, TestInsert) {
+  Terrain::ChunkStore store(World::Coordinates(-2, 0, -2, 2, 0, 2, Map::NW));
+
+  // Neighbours of the fragment are stored, chunks further away are not
+  for (int32_t z = -3; z < 4; z++)
+    store.insert(placeholder({0, z}));
+
+  for (int32_t z = -3; z < 4; z++)
+    ASSERT_NE(store.find({0, z}), nullptr);
+
+  store.insert(placeholder({0, -4}));
+  ASSERT_EQ(store.find({0, -4}), nullptr);
+
+  store.erase({0, 1});
+  ASSERT_EQ(store.find({0, 1}), nullptr);
+  ASSERT_NE(store.find({0, 2}), nullptr);
+}
+
+TEST(TestChunkStore, TestWindow) {
+  Terrain::ChunkStore store(World::Coordinates(-2, 0, -2, 2, 0, 2, Map::SE));
+
+  // Two rows are kept: a third replaces the first
+  store.insert(placeholder({-1, 0}));
+  store.insert(placeholder({-2, 0}));
+  ASSERT_NE(store.find({-1, 0}), nullptr);
+  ASSERT_NE(store.find({-2, 0}), nullptr);
+
+  store.insert(placeholder({-3, 0}));
+  ASSERT_EQ(store.find({-1, 0}), nullptr);
+  ASSERT_NE(store.find({-2, 0}), nullptr);
+  ASSERT_NE(store.find({-3, 0}), nullptr);
+}
+
+TEST(TestChunkStore, TestOrientation) {
+  Terrain::ChunkStore store(World::Coordinates(0, 0, 0, 3, 0, 3, Map::NE));
+
+  // Rows go along x, the chunks of a row sharing their z coordinate
+  for (int32_t x = -1; x < 5; x++)
+    store.insert(placeholder({x, 0}));
+
+  for (int32_t x = -1; x < 5; x++)
+    ASSERT_NE(store.find({x, 0}), nullptr);
+
+  store.insert(placeholder({0, 2}));
+  ASSERT_EQ(store.find({0, 0}), nullptr);
+  ASSERT_NE(store.find({1, 0}), nullptr);
+}
+
+TEST(TestChunkStore, TestWhole) {
+  Terrain::ChunkStore store(World::Coordinates(-2, 0, -2, 2, 0, 2, Map::SE),
+                            true);
+
+  // Every chunk of the fragment and its margin is kept, and never freed
+  for (int32_t x = -3; x < 4; x++)
+    for (int32_t z = -3; z < 4; z++)
+      store.insert(placeholder({x, z}));
+
+  store.erase({0, 0});
+
+  for (int32_t x = -3; x < 4; x++)
+    for (int32_t z = -3; z < 4; z++)
+      ASSERT_NE(store.find({x, z}), nullptr);
+
+  store.insert(placeholder({-4, 0}));
+  store.insert(placeholder({0, 4}));
+  ASSERT_EQ(store.find({-4, 0}), nullptr);
+  ASSERT_EQ(store.find({0, 4}), nullptr);
+}